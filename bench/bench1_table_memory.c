@@ -0,0 +1,53 @@
+/*
+ * Reports the memory used to track n live allocations: first with just the
+ * hash table, then once the address index has been built (by an interior
+ * pointer check). Compared against the table layout this library started
+ * with: 24 byte entries (location, size, checksum) kept at most 50% full,
+ * which had no address index at all.
+ */
+#define DEBUG_MEM_ENABLE
+#include <debug_mem.h>
+#include <inttypes.h>
+
+#define BENCHNAME "bench1_table_memory"
+#define INITIAL_CAPACITY 16
+
+static size_t previous_layout_memory( size_t n )
+{
+    size_t capacity = INITIAL_CAPACITY;
+    while ( n > capacity / 2 )
+        capacity *= 2;
+    return capacity * 24;
+}
+
+int main()
+{
+    static void *buffers[1000000];
+    size_t counts[] = { 1000, 10000, 100000, 1000000 };
+    printf( "%10s %12s %10s %12s %10s %12s %10s\n", "live", "table",
+            "per alloc", "+index", "per alloc", "previous", "per alloc" );
+    for ( size_t c = 0; c < sizeof( counts ) / sizeof( counts[0] ); c++ ) {
+        size_t n = counts[c];
+        int err = debug_mem_init_compressed( "memory_" BENCHNAME ".log",
+                                             INITIAL_CAPACITY );
+        if ( err ) {
+            fprintf( stderr, "Failed to initialise memory debugger\n" );
+            return 1;
+        }
+        if ( malloc_batch( buffers, n, 16 ) ) {
+            fprintf( stderr, "Failed to allocate %zu buffers\n", n );
+            return 1;
+        }
+        size_t table_bytes = debug_mem_table_memory();
+        debug_mem_check_range( ( char * ) buffers[0] + 1, 1 );
+        size_t index_bytes = debug_mem_table_memory();
+        size_t previous = previous_layout_memory( n );
+        printf( "%10zu %12zu %10.1f %12zu %10.1f %12zu %10.1f\n", n,
+                table_bytes, ( double ) table_bytes / ( double ) n,
+                index_bytes, ( double ) index_bytes / ( double ) n,
+                previous, ( double ) previous / ( double ) n );
+        free_batch( buffers, n );
+        debug_mem_end();
+    }
+    return 0;
+}
@@ -0,0 +1,111 @@
+/*
+ * Compares the size of, and time taken to write, the plain and compressed
+ * logs for a workload of 2M malloc/free calls from several call sites, with
+ * varying sizes and interleaved lifetimes. Each mode is run RUNS times and
+ * the fastest run is reported. The compressed log is meant to be at least 10x
+ * smaller than the plain one, and quicker to write.
+ */
+#define DEBUG_MEM_ENABLE
+#include <debug_mem.h>
+#include <inttypes.h>
+#include <time.h>
+
+#define BENCHNAME "bench2_log_compression"
+#define LIVE 4096
+#define CALLS 2000000
+#define RUNS 3
+
+static void *live[LIVE];
+static uint32_t rng_state = 12345;
+
+static uint32_t rng()
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static void *parser_alloc( size_t size )
+{
+    return malloc( size );
+}
+
+static void *network_alloc( size_t size )
+{
+    return calloc( size, 1 );
+}
+
+static void release( void *p )
+{
+    free( p );
+}
+
+static void workload()
+{
+    for ( size_t i = 0; i < CALLS / 2; i++ ) {
+        size_t slot = rng() % LIVE;
+        if ( live[slot] != NULL )
+            release( live[slot] );
+        size_t size = 16 + rng() % 512;
+        live[slot] = ( i & 1 ) ? parser_alloc( size ) : network_alloc( size );
+    }
+    for ( size_t slot = 0; slot < LIVE; slot++ ) {
+        if ( live[slot] != NULL ) {
+            release( live[slot] );
+            live[slot] = NULL;
+        }
+    }
+}
+
+static double seconds()
+{
+    struct timespec ts;
+    timespec_get( &ts, TIME_UTC );
+    return ( double ) ts.tv_sec + ( double ) ts.tv_nsec / 1e9;
+}
+
+static long file_size( const char *name )
+{
+    FILE *file = fopen( name, "rb" );
+    if ( file == NULL )
+        return -1;
+    fseek( file, 0, SEEK_END );
+    long size = ftell( file );
+    fclose( file );
+    return size;
+}
+
+int main()
+{
+    const char *names[] = { "memory_" BENCHNAME "_plain.log",
+                            "memory_" BENCHNAME "_compressed.log"
+                          };
+    long sizes[2];
+    double times[2];
+    for ( int compressed = 0; compressed < 2; compressed++ ) {
+        for ( int run = 0; run < RUNS; run++ ) {
+            rng_state = 12345;
+            double start = seconds();
+            int err = compressed
+                      ? debug_mem_init_compressed( names[compressed], 1024 )
+                      : debug_mem_init( names[compressed], 1024 );
+            if ( err ) {
+                fprintf( stderr, "Failed to initialise memory debugger\n" );
+                return 1;
+            }
+            workload();
+            debug_mem_end();
+            double elapsed = seconds() - start;
+            if ( run == 0 || elapsed < times[compressed] )
+                times[compressed] = elapsed;
+        }
+        sizes[compressed] = file_size( names[compressed] );
+    }
+    printf( "%12s %14s %10s\n", "log", "bytes", "seconds" );
+    printf( "%12s %14ld %10.3f\n", "plain", sizes[0], times[0] );
+    printf( "%12s %14ld %10.3f\n", "compressed", sizes[1], times[1] );
+    printf( "ratio %.2fx, time %.2fx\n", ( double ) sizes[0] / ( double ) sizes[1],
+            times[1] / times[0] );
+    return 0;
+}
@@ -0,0 +1,77 @@
+/*
+ * Compares allocating and freeing ROUNDS batches of BATCH buffers through
+ * malloc_batch/free_batch against looping over malloc/free, with the plain
+ * and the compressed log. The fastest of RUNS runs of each is reported.
+ */
+#define DEBUG_MEM_ENABLE
+#include <debug_mem.h>
+#include <inttypes.h>
+#include <time.h>
+
+#define BENCHNAME "bench3_batch_alloc"
+#define BATCH 1000
+#define ROUNDS 1000
+#define RUNS 3
+
+static void *buffers[BATCH];
+
+static void loop_workload()
+{
+    for ( size_t round = 0; round < ROUNDS; round++ ) {
+        for ( size_t i = 0; i < BATCH; i++ )
+            buffers[i] = malloc( 32 );
+        for ( size_t i = 0; i < BATCH; i++ )
+            free( buffers[i] );
+    }
+}
+
+static void batch_workload()
+{
+    for ( size_t round = 0; round < ROUNDS; round++ ) {
+        if ( malloc_batch( buffers, BATCH, 32 ) )
+            return;
+        free_batch( buffers, BATCH );
+    }
+}
+
+static double seconds()
+{
+    struct timespec ts;
+    timespec_get( &ts, TIME_UTC );
+    return ( double ) ts.tv_sec + ( double ) ts.tv_nsec / 1e9;
+}
+
+static double best_time( void ( *workload )(), int compressed )
+{
+    double best = 0;
+    for ( int run = 0; run < RUNS; run++ ) {
+        double start = seconds();
+        int err = compressed
+                  ? debug_mem_init_compressed( "memory_" BENCHNAME ".log", 1024 )
+                  : debug_mem_init( "memory_" BENCHNAME ".log", 1024 );
+        if ( err ) {
+            fprintf( stderr, "Failed to initialise memory debugger\n" );
+            return -1;
+        }
+        workload();
+        debug_mem_end();
+        double elapsed = seconds() - start;
+        if ( run == 0 || elapsed < best )
+            best = elapsed;
+    }
+    return best;
+}
+
+int main()
+{
+    printf( "%12s %10s %10s %10s\n", "log", "loop", "batch", "speedup" );
+    for ( int compressed = 0; compressed < 2; compressed++ ) {
+        double loop = best_time( loop_workload, compressed );
+        double batch = best_time( batch_workload, compressed );
+        if ( loop < 0 || batch < 0 )
+            return 1;
+        printf( "%12s %10.3f %10.3f %9.2fx\n",
+                compressed ? "compressed" : "plain", loop, batch, loop / batch );
+    }
+    return 0;
+}
@@ -44,14 +44,46 @@
 #define malloc(n)         debug_mem_malloc(n, __FILE__, __LINE__, __func__)
 #define calloc(n, s)      debug_mem_calloc(n, s, __FILE__, __LINE__, __func__)
 #define free(n)           debug_mem_free(n, __FILE__, __LINE__, __func__)
-#define pass_pointer(type, n)   (type) debug_mem_pass_pointer((void *) n, __FILE__, __LINE__, __func__)
-#define return_pointer(type, n)  return (type) debug_mem_return_pointer((void *) n, __FILE__, __LINE__, __func__)
+#define pass_pointer(type, n)   (type) debug_mem_pass_pointer((void *) (n), __FILE__, __LINE__, __func__)
+#define return_pointer(type, n)  return (type) debug_mem_return_pointer((void *) (n), __FILE__, __LINE__, __func__)
+#define malloc_batch(p, n, s)   debug_mem_malloc_batch((void **) (p), n, s, __FILE__, __LINE__, __func__)
+#define free_batch(p, n)        debug_mem_free_batch((void **) (p), n, __FILE__, __LINE__, __func__)
 #else
-#define pass_pointer(type, n)    n
-#define return_pointer(type, n)  n
+#define pass_pointer(type, n)    (n)
+#define return_pointer(type, n)  return (n)
+#define malloc_batch(p, n, s)    debug_mem_plain_malloc_batch((void **) (p), n, s)
+#define free_batch(p, n)         debug_mem_plain_free_batch((void **) (p), n)
+
+// plain versions of the batch functions for when the system is disabled
+static inline int debug_mem_plain_malloc_batch(
+    void **buffers, size_t count, size_t size )
+{
+    for ( size_t i = 0; i < count; i++ ) {
+        buffers[i] = malloc( size );
+        if ( buffers[i] == NULL ) {
+            for ( size_t j = 0; j < i; j++ ) {
+                free( buffers[j] );
+                buffers[j] = NULL;
+            }
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static inline void debug_mem_plain_free_batch( void **buffers, size_t count )
+{
+    for ( size_t i = 0; i < count; i++ )
+        free( buffers[i] );
+}
+#endif
+
+#ifdef __cplusplus
+extern "C" {
 #endif
 
 extern int debug_mem_init( const char*, size_t );
+extern int debug_mem_init_compressed( const char*, size_t );
 extern size_t debug_mem_end();
 extern void *debug_mem_malloc(
     size_t,  const char*,
@@ -62,13 +94,31 @@ extern void *debug_mem_calloc(
 extern void debug_mem_free(
     void *,    const char*,
     unsigned int,    const char* );
+extern int debug_mem_malloc_batch(
+    void **,    size_t,    size_t,
+    const char*,    unsigned int,    const char* );
+extern void debug_mem_free_batch(
+    void **,    size_t,
+    const char*,    unsigned int,    const char* );
+extern int debug_mem_free_sized(
+    void *,    size_t,    const char*,
+    unsigned int,    const char* );
 extern void *debug_mem_pass_pointer(
     void *,    const char*,
     unsigned int,    const char* );
 extern int debug_mem_check( const void* );
+extern int debug_mem_check_range( const void*, size_t );
 extern size_t debug_mem_check_all( );
 extern size_t debug_mem_table_length();
 extern size_t debug_mem_table_capacity();
+extern size_t debug_mem_table_memory();
+
+extern int debug_mem_domain( const char* );
+extern int debug_mem_domain_push( const char* );
+extern int debug_mem_domain_pop();
+extern size_t debug_mem_domain_length( int );
+extern size_t debug_mem_domain_check_all( int );
+extern size_t debug_mem_domain_report( int );
 
 extern void *debug_mem_pass_pointer(
     void *, const char*,
@@ -77,4 +127,8 @@ extern void *debug_mem_pass_pointer(
 extern void *debug_mem_return_pointer(
     void *, const char*,
     unsigned int, const char* );
+
+#ifdef __cplusplus
+}
+#endif
 #endif
@@ -0,0 +1,77 @@
+/*
+ * C++ companion to debug_mem.h
+ *
+ * The malloc/free macros can't see new and delete, so this provides:
+ * + Tracked replacements for the global operator new/delete (including the
+ *   array, nothrow and aligned variants), these live in the debug_mem_cpp
+ *   library and are active in any program linked against it. Sized delete
+ *   passes its size on to debug_mem_free_sized, so the buffer's checksum is
+ *   verified as it is deleted.
+ * + debug_mem::allocator, a tracking allocator for standard containers, which
+ *   is plain std::allocator when DEBUG_MEM_ENABLE is not defined.
+ *
+ * Include this after any standard library headers, debug_mem.h defines
+ * malloc, calloc and free as macros.
+ *
+ * As with the C interface, debug_mem_end frees anything still tracked, so
+ * objects allocated while tracking is enabled must be deleted before then.
+ */
+#ifndef DEBUG_MEM_HPP
+#define DEBUG_MEM_HPP
+
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <new>
+
+#include "debug_mem.h"
+
+namespace debug_mem {
+
+#ifdef DEBUG_MEM_ENABLE
+template <class T>
+struct allocator {
+    static_assert( alignof( T ) <= alignof( std::max_align_t ),
+                   "debug_mem::allocator does not support over-aligned types" );
+    using value_type = T;
+
+    allocator() noexcept = default;
+    template <class U>
+    allocator( const allocator<U>& ) noexcept {}
+
+    T* allocate( std::size_t n )
+    {
+        if ( n > std::numeric_limits<std::size_t>::max() / sizeof( T ) )
+            throw std::bad_array_new_length();
+        void *p = debug_mem_malloc( n * sizeof( T ), __FILE__, __LINE__,
+                                    "debug_mem::allocator::allocate" );
+        if ( p == nullptr )
+            throw std::bad_alloc();
+        return static_cast<T*>( p );
+    }
+
+    void deallocate( T* p, std::size_t n ) noexcept
+    {
+        debug_mem_free_sized( p, n * sizeof( T ), __FILE__, __LINE__,
+                              "debug_mem::allocator::deallocate" );
+    }
+};
+
+template <class T, class U>
+bool operator==( const allocator<T>&, const allocator<U>& ) noexcept
+{
+    return true;
+}
+
+template <class T, class U>
+bool operator!=( const allocator<T>&, const allocator<U>& ) noexcept
+{
+    return false;
+}
+#else
+template <class T>
+using allocator = std::allocator<T>;
+#endif
+
+} // namespace debug_mem
+#endif
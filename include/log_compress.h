@@ -0,0 +1,81 @@
+#ifndef LOG_COMPRESS_H
+#define LOG_COMPRESS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdbool.h>
+
+// Compressed log file layout:
+//   "DMLZ" + version byte, followed by any number of blocks, each being
+//   varint(raw length) varint(compressed length) <compressed bytes>
+// Blocks are independent of each other, so a log which was not closed with
+// debug_mem_end is readable up to the last complete block.
+//
+// The raw bytes of the blocks, taken together, are a stream of binary records
+// rather than text. Each record is a tag byte followed by varints:
+//   LOG_RECORD_STRING  length <bytes>           defines the next string id
+//   LOG_RECORD_SITE    file func line           defines the next call site id
+//   LOG_RECORD_TEXT    length <bytes>           a line logged as text
+//   LOG_RECORD_EVENT + event  site <fields>     see LogEvent
+// File and function names are only written once, in their string record, and
+// (file, function, line) once per call site. Addresses are written as the
+// zigzag encoded difference from the previous address in the stream, so
+// addresses close to each other take a couple of bytes rather than 12 hex
+// digits. log_decompress_stream renders the records back into the text that
+// debug_mem_init would have written.
+#define LOG_COMPRESS_MAGIC "DMLZ"
+#define LOG_COMPRESS_VERSION 2
+#define LOG_COMPRESS_BLOCK_SIZE ( 64 * 1024 )
+// worst case size of a compressed block of n bytes (all literals)
+#define LOG_COMPRESS_BOUND(n) ( ( n ) + ( n ) / 128 + 16 )
+
+#define LOG_RECORD_STRING 0
+#define LOG_RECORD_SITE 1
+#define LOG_RECORD_TEXT 2
+#define LOG_RECORD_EVENT 3
+
+// the fields of each event's record, after its site
+typedef enum {
+    LOG_MALLOC,         // address size
+    LOG_CALLOC,         // address nmemb size
+    LOG_FREE,           // address
+    LOG_FREE_SIZED,     // address size
+    LOG_PASS_POINTER,   // address
+    LOG_RETURN_POINTER, // address
+    LOG_MALLOC_BATCH,   // count size address...
+    LOG_FREE_BATCH,     // count address...
+    LOG_EVENTS
+} LogEvent;
+
+typedef struct LogWriter LogWriter;
+
+extern size_t log_compress_block( const unsigned char *in, size_t in_length,
+                                  unsigned char *out );
+extern bool log_decompress_block( const unsigned char *in, size_t in_length,
+                                  unsigned char *out, size_t out_length );
+extern bool log_write_header( FILE *file );
+extern bool log_write_block( FILE *file, const unsigned char *raw,
+                             size_t raw_length, unsigned char *scratch );
+extern int log_decompress_stream( FILE *in, FILE *out );
+
+extern LogWriter* log_writer_open( FILE *file );
+extern bool log_writer_close( LogWriter* writer );
+extern void log_record_text( LogWriter* writer, const char *text,
+                             size_t length );
+extern void log_record_event( LogWriter* writer, LogEvent event,
+                              const char *file, unsigned int line,
+                              const char *func, uintptr_t address,
+                              size_t a, size_t b );
+extern void log_record_batch( LogWriter* writer, LogEvent event,
+                              const char *file, unsigned int line,
+                              const char *func, void *const *addresses,
+                              size_t count, size_t size );
+extern void log_render_event( FILE *out, LogEvent event, const char *file,
+                              unsigned int line, const char *func,
+                              uintptr_t address, size_t a, size_t b );
+extern void log_render_batch( FILE *out, LogEvent event, const char *file,
+                              unsigned int line, const char *func,
+                              void *const *addresses, size_t count,
+                              size_t size );
+#endif
@@ -0,0 +1,28 @@
+#ifndef MEM_DOMAIN_H
+#define MEM_DOMAIN_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Which domain each allocation belongs to, for the allocations outside of
+// domain 0. Every domain other than 0 is an intrusive list threaded through
+// the entries of one hash map keyed on the allocation's location, so walking
+// a domain visits only its own allocations. Domain 0 is everything that is
+// not in the map, it has no list.
+typedef struct MemDomains MemDomains;
+
+#define DOMAIN_MAX 64
+
+extern MemDomains* domain_init();
+extern void domain_destroy( MemDomains* domains );
+extern bool domain_insert( MemDomains* domains, uintptr_t location,
+                           unsigned int domain );
+extern bool domain_remove( MemDomains* domains, uintptr_t location );
+extern bool domain_contains( MemDomains* domains, uintptr_t location );
+extern size_t domain_length( MemDomains* domains, unsigned int domain );
+extern size_t domain_total( MemDomains* domains );
+extern uintptr_t domain_first( MemDomains* domains, unsigned int domain );
+extern uintptr_t domain_next( MemDomains* domains, uintptr_t location );
+extern size_t domain_memory( MemDomains* domains );
+#endif
@@ -0,0 +1,20 @@
+#ifndef MEM_RANGE_H
+#define MEM_RANGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Ordered index of allocations by address, used to find the allocation that
+// an interior pointer belongs to. The hash table only answers exact lookups.
+// Sizes are not kept here, the hash table already has them.
+typedef struct MemRange MemRange;
+
+extern MemRange* range_init();
+extern void range_destroy( MemRange* range );
+extern bool range_insert( MemRange* range, uintptr_t start );
+extern bool range_remove( MemRange* range, uintptr_t start );
+extern size_t range_memory( MemRange* range );
+extern bool range_find( MemRange* range, uintptr_t address,
+                        uintptr_t *start_pointer );
+#endif
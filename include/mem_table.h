@@ -21,6 +21,11 @@ typedef struct {
 
     MemHT* _table;
     size_t _index;
+    // iterating a domain other than 0 follows its list from _next, domain 0
+    // iterates the whole table skipping allocations that are in a domain
+    bool _by_domain;
+    unsigned int _domain;
+    uintptr_t _next;
 } HTIter;
 
 extern MemHT* table_init( size_t initial_capacity );
@@ -29,8 +34,23 @@ extern size_t table_capacity( MemHT* table );
 extern size_t table_destroy( MemHT* table );
 extern uintptr_t table_set( MemHT* table, uintptr_t location, size_t size );
 extern bool table_remove( MemHT* table, const void *location );
+extern bool table_take( MemHT* table, const void *location,
+                        size_t *size_pointer );
+extern bool table_reserve( MemHT* table, size_t additional );
+extern size_t table_set_batch( MemHT* table, void *const *locations,
+                               size_t count, size_t size );
+extern size_t table_remove_batch( MemHT* table, void *const *locations,
+                                  size_t count );
 extern bool table_get( MemHT* table, const void *location,
                        size_t *size_pointer, checksum_t *checksum_pointer );
+extern bool table_find( MemHT* table, const void *address,
+                        const void **location_pointer, size_t *size_pointer,
+                        checksum_t *checksum_pointer );
+extern size_t table_memory( MemHT* table );
+extern checksum_t table_checksum( uintptr_t location );
 extern HTIter table_iterator( MemHT* table );
 extern bool table_iter_next( HTIter* iterator );
+extern bool table_set_domain( MemHT* table, unsigned int domain );
+extern size_t table_domain_length( MemHT* table, unsigned int domain );
+extern HTIter table_domain_iterator( MemHT* table, unsigned int domain );
 #endif
@@ -3,25 +3,104 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <inttypes.h>
+#include <stdarg.h>
+#include <string.h>
 #include "debug_mem.h"
 #include "mem_table.h"
+#include "mem_domain.h"
+#include "log_compress.h"
 /* #include <stdint.h> */
 
+// how deeply debug_mem_domain_push calls may be nested
+#define DEBUG_MEM_DOMAIN_DEPTH 32
+
 static FILE *logfile;
 static bool initialised;
 static MemHT* table;
+// only used in compressed mode, events are written to it as binary records
+// and everything else as text records
+static LogWriter *log_writer;
+// domain 0 holds every allocation made outside of a pushed domain
+static const char *domain_names[DOMAIN_MAX] = { "(default)" };
+static size_t n_domains = 1;
+static unsigned int domain_stack[DEBUG_MEM_DOMAIN_DEPTH];
+static size_t domain_depth;
 
-// set initial_capacity to 0 to disable memory checking
-extern int debug_mem_init( const char* log_location, size_t initial_capacity )
+static void debug_mem_log( const char* format, ... )
+{
+    va_list args;
+    va_start( args, format );
+    if ( log_writer == NULL ) {
+        vfprintf( logfile, format, args );
+    } else {
+        va_list retry;
+        va_copy( retry, args );
+        char line[256];
+        int n = vsnprintf( line, sizeof( line ), format, args );
+        if ( n >= 0 && ( size_t ) n < sizeof( line ) ) {
+            log_record_text( log_writer, line, ( size_t ) n );
+        } else if ( n >= 0 ) {
+            char *long_line = malloc( ( size_t ) n + 1 );
+            if ( long_line != NULL ) {
+                vsnprintf( long_line, ( size_t ) n + 1, format, retry );
+                log_record_text( log_writer, long_line, ( size_t ) n );
+                free( long_line );
+            }
+        }
+        va_end( retry );
+    }
+    va_end( args );
+}
+
+// allocation events, written as compact records in compressed mode
+static void debug_mem_log_event( LogEvent event, const char* filename,
+                                 unsigned int line, const char* func,
+                                 const void *p, size_t a, size_t b )
+{
+    if ( log_writer != NULL )
+        log_record_event( log_writer, event, filename, line, func,
+                          ( uintptr_t ) p, a, b );
+    else
+        log_render_event( logfile, event, filename, line, func,
+                          ( uintptr_t ) p, a, b );
+}
+
+static void debug_mem_log_batch( LogEvent event, const char* filename,
+                                 unsigned int line, const char* func,
+                                 void *const *buffers, size_t count,
+                                 size_t size )
+{
+    if ( log_writer != NULL )
+        log_record_batch( log_writer, event, filename, line, func, buffers,
+                          count, size );
+    else
+        log_render_batch( logfile, event, filename, line, func, buffers,
+                          count, size );
+}
+
+static int debug_mem_start( const char* log_location, size_t initial_capacity,
+                            bool compressed )
 {
     if ( !initialised ) {
-        logfile = fopen( log_location, "w" );
+        logfile = fopen( log_location, compressed ? "wb" : "w" );
         if ( logfile == NULL )
             return 1;
+        if ( compressed ) {
+            log_writer = log_writer_open( logfile );
+            if ( log_writer == NULL ) {
+                fclose( logfile );
+                return 3;
+            }
+        }
         if ( initial_capacity ) {
             MemHT *ht = table_init( initial_capacity );
             if ( ht == NULL )
                 return 2;
+            if ( domain_depth > 0
+                    && !table_set_domain( ht, domain_stack[domain_depth - 1] ) ) {
+                table_destroy( ht );
+                return 2;
+            }
             table = ht;
         }
         initialised = true;
@@ -29,26 +108,46 @@ extern int debug_mem_init( const char* log_location, size_t initial_capacity )
     return 0;
 }
 
+// set initial_capacity to 0 to disable memory checking
+extern int debug_mem_init( const char* log_location, size_t initial_capacity )
+{
+    return debug_mem_start( log_location, initial_capacity, false );
+}
+
+// as debug_mem_init, but the log is written as binary records, compressed in
+// blocks (see log_compress.h), use debug_mem_decompress to read it back
+extern int debug_mem_init_compressed( const char* log_location,
+                                      size_t initial_capacity )
+{
+    return debug_mem_start( log_location, initial_capacity, true );
+}
+
+// the bytes just past the end of buf, where its checksum was written
+static inline checksum_t debug_mem_stored_checksum( const void* buf,
+                                                    size_t buffer_size )
+{
+    checksum_t cmp_checksum;
+    memcpy( &cmp_checksum, &( ( const char * ) buf )[buffer_size],
+            sizeof( checksum_t ) );
+    return cmp_checksum;
+}
+
 static int debug_mem_checker( const void* buf, size_t buffer_size,
                               checksum_t checksum )
 {
-    checksum_t cmp_checksum = *( checksum_t * )  &( ( char * ) buf )[buffer_size] ;
+    checksum_t cmp_checksum = debug_mem_stored_checksum( buf, buffer_size );
     if ( checksum == cmp_checksum ) {
         if ( initialised )
-            fprintf(
-                logfile,
-                "Checking buffer @%" PRIXPTR " successful: checksum %"
-                PRIXCKSM " matches last byte %" PRIXCKSM "\n",
-                ( uintptr_t ) buf, checksum, cmp_checksum );
+            debug_mem_log( "Checking buffer @%" PRIXPTR " successful: checksum %"
+                           PRIXCKSM " matches last byte %" PRIXCKSM "\n",
+                           ( uintptr_t ) buf, checksum, cmp_checksum );
         return 0;
     } else {
         if ( initialised )
-            fprintf(
-                logfile,
-                "Checking buffer @%" PRIXPTR
-                " unsuccessful: checksum %" PRIXCKSM
-                " does not match last byte %" PRIXCKSM "\n",
-                ( uintptr_t ) buf, checksum, cmp_checksum );
+            debug_mem_log( "Checking buffer @%" PRIXPTR
+                           " unsuccessful: checksum %" PRIXCKSM
+                           " does not match last byte %" PRIXCKSM "\n",
+                           ( uintptr_t ) buf, checksum, cmp_checksum );
         return 1;
     }
 }
@@ -56,28 +155,77 @@ static int debug_mem_checker( const void* buf, size_t buffer_size,
 // return 0: entry found and checksum cleared
 // return 1: entry found but checksum not correct
 // return -1: entry not found
+// buf may point anywhere inside the allocation, not just at its start
 // Also returns 0 if memory checking is not enabled
 extern int debug_mem_check( const void* buf )
 {
     if ( table != NULL ) {
+        const void *location;
         size_t buffer_size;
         checksum_t checksum;
+        // pointers to the start of an allocation are found in the hash table,
+        // so checking them doesn't build the address index. A miss stops at
+        // the first empty slot, then the index finds interior pointers in
+        // O(log n)
         if ( table_get( table, buf, &buffer_size, &checksum ) ) {
             return debug_mem_checker( buf, buffer_size, checksum );
+        } else if ( table_find( table, buf, &location, &buffer_size,
+                                &checksum ) ) {
+            return debug_mem_checker( location, buffer_size, checksum );
         } else {
             if ( initialised )
-                fprintf(
-                    logfile,
-                    "Attempted to check buffer @%" PRIXPTR
-                    " when memory checking is not enabled, enable\
-                        memory checking by passing `true` to debug_mem_init\n",
-                    ( uintptr_t ) buf );
+                debug_mem_log( "Attempted to check buffer @%" PRIXPTR
+                               " which is not a tracked allocation\n",
+                               ( uintptr_t ) buf );
             return -1;
         }
     }
     return 0;
 }
 
+// check that the length bytes from buf lie within a single tracked
+// allocation, as well as checking that allocation as debug_mem_check does
+// return 0: range is inside an allocation whose checksum is intact
+// return 1: range runs past the end of its allocation, or checksum not correct
+// return -1: buf is not inside any tracked allocation
+// Also returns 0 if memory checking is not enabled
+extern int debug_mem_check_range( const void* buf, size_t length )
+{
+    if ( table == NULL )
+        return 0;
+    const void *location;
+    size_t buffer_size;
+    checksum_t checksum;
+    if ( !table_find( table, buf, &location, &buffer_size, &checksum ) ) {
+        if ( initialised )
+            debug_mem_log( "Attempted to check range @%" PRIXPTR
+                           " (%zu bytes) which is not inside a tracked"
+                           " allocation\n", ( uintptr_t ) buf, length );
+        return -1;
+    }
+    size_t offset = ( size_t )( ( uintptr_t ) buf - ( uintptr_t ) location );
+    if ( length > buffer_size - offset ) {
+        if ( initialised )
+            debug_mem_log( "Checking range @%" PRIXPTR " (%zu bytes)"
+                           " unsuccessful: only %zu bytes remain in buffer @%"
+                           PRIXPTR "\n", ( uintptr_t ) buf, length,
+                           buffer_size - offset, ( uintptr_t ) location );
+        return 1;
+    }
+    return debug_mem_checker( location, buffer_size, checksum );
+}
+
+static size_t debug_mem_check_iter( HTIter *iter )
+{
+    size_t errors = 0;
+    while ( table_iter_next( iter ) ) {
+        if ( debug_mem_checker( iter->location, iter->size, iter->checksum ) ) {
+            errors ++;
+        }
+    }
+    return errors;
+}
+
 // returns the number of allocations which either were not in the table,
 // or had overwritten their checksum bytes
 extern size_t debug_mem_check_all()
@@ -85,34 +233,130 @@ extern size_t debug_mem_check_all()
     if ( table == NULL )
         return 0;
     if ( table_length( table ) == 0 ) {
-        fprintf( logfile, "debug_mem_check_all cannot be used when memory\
+        debug_mem_log( "debug_mem_check_all cannot be used when memory\
                   checking is not enabled\n" );
         return 0;
     }
     HTIter iter = table_iterator( table );
-    size_t errors = 0;
-    while ( table_iter_next( &iter ) ) {
-        if ( debug_mem_checker( iter.location, iter.size, iter.checksum ) ) {
-            errors ++;
-        }
+    size_t errors = debug_mem_check_iter( &iter );
+    debug_mem_log( "CheckAll Summary: %" PRIuPTR " of %"
+                   PRIuPTR " allocations failed boundary verification\n",
+                   errors, table_length( table ) );
+    return errors;
+}
+
+// returns the id of the domain called name, or -1 if no domain of that name
+// has been pushed
+extern int debug_mem_domain( const char* name )
+{
+    for ( size_t i = 0; i < n_domains; i++ ) {
+        if ( strcmp( domain_names[i], name ) == 0 )
+            return ( int ) i;
     }
-    fprintf( logfile, "CheckAll Summary: %" PRIuPTR " of %"
-             PRIuPTR " allocations failed boundary verification\n",
-             errors, table_length( table ) );
+    return -1;
+}
+
+// returns the id of the domain called name, registering it if it is new, or
+// -1 if DOMAIN_MAX domains already exist. The name is not copied so it must
+// remain valid until debug_mem_end
+static int debug_mem_domain_register( const char* name )
+{
+    int domain = debug_mem_domain( name );
+    if ( domain >= 0 )
+        return domain;
+    if ( n_domains == DOMAIN_MAX )
+        return -1;
+    domain_names[n_domains] = name;
+    return ( int ) n_domains++;
+}
+
+// allocations are added to the named domain until the matching
+// debug_mem_domain_pop, returns the domain's id or -1 if there are too many
+// domains, they are nested too deeply or the map that tracks them can't be
+// allocated. A name is registered as a domain by its first push
+extern int debug_mem_domain_push( const char* name )
+{
+    int domain = debug_mem_domain_register( name );
+    if ( domain < 0 || domain_depth == DEBUG_MEM_DOMAIN_DEPTH )
+        return -1;
+    if ( table != NULL && !table_set_domain( table, ( unsigned int ) domain ) )
+        return -1;
+    domain_stack[domain_depth++] = ( unsigned int ) domain;
+    return domain;
+}
+
+// returns the id of the domain which was popped, or -1 if none was pushed
+extern int debug_mem_domain_pop()
+{
+    if ( domain_depth == 0 )
+        return -1;
+    unsigned int domain = domain_stack[--domain_depth];
+    if ( table != NULL )
+        table_set_domain( table, domain_depth > 0
+                          ? domain_stack[domain_depth - 1] : 0 );
+    return ( int ) domain;
+}
+
+static bool debug_mem_domain_valid( int domain )
+{
+    return table != NULL && domain >= 0 && ( size_t ) domain < n_domains;
+}
+
+extern size_t debug_mem_domain_length( int domain )
+{
+    if ( !debug_mem_domain_valid( domain ) )
+        return 0;
+    return table_domain_length( table, ( unsigned int ) domain );
+}
+
+// as debug_mem_check_all, but only checks the allocations in domain. Only the
+// domain's own allocations are visited, except for domain 0 which has no list:
+// checking it walks the whole table, the same as debug_mem_check_all
+extern size_t debug_mem_domain_check_all( int domain )
+{
+    if ( !debug_mem_domain_valid( domain ) )
+        return 0;
+    HTIter iter = table_domain_iterator( table, ( unsigned int ) domain );
+    size_t errors = debug_mem_check_iter( &iter );
+    debug_mem_log( "CheckAll Summary (domain %s): %zu of %zu allocations"
+                   " failed boundary verification\n", domain_names[domain],
+                   errors, table_domain_length( table, ( unsigned int ) domain ) );
     return errors;
 }
 
+// logs every allocation still in domain, returning how many there are. Like
+// debug_mem_domain_check_all this walks the whole table for domain 0
+extern size_t debug_mem_domain_report( int domain )
+{
+    if ( !debug_mem_domain_valid( domain ) )
+        return 0;
+    size_t n_unfreed = table_domain_length( table, ( unsigned int ) domain );
+    debug_mem_log( "Domain %s has %zu un-freed items\n",
+                   domain_names[domain], n_unfreed );
+    HTIter iter = table_domain_iterator( table, ( unsigned int ) domain );
+    while ( table_iter_next( &iter ) )
+        debug_mem_log( "    @%" PRIXPTR " (%zu bytes)\n",
+                       ( uintptr_t ) iter.location, iter.size );
+    return n_unfreed;
+}
+
 extern size_t debug_mem_end()
 {
     size_t n_unfreed = 0;
     if ( table != NULL ) {
         n_unfreed = table_destroy( table );
-        fprintf( logfile,
-                 "Destroyed allocation table with %zu un-freed items\n",
-                 n_unfreed );
+        debug_mem_log( "Destroyed allocation table with %zu un-freed items\n",
+                       n_unfreed );
         table = NULL;
     }
+    if ( log_writer != NULL ) {
+        log_writer_close( log_writer );
+        log_writer = NULL;
+    }
     fclose( logfile );
+    initialised = false;
+    n_domains = 1;
+    domain_depth = 0;
     return n_unfreed;
 }
 
@@ -132,12 +376,20 @@ extern size_t debug_mem_table_capacity()
         return 0;
 }
 
+// bytes used by the allocation table and its address index
+extern size_t debug_mem_table_memory()
+{
+    if ( table != NULL )
+        return table_memory( table );
+    else
+        return 0;
+}
+
 extern void *debug_mem_pass_pointer( void *p, const char* filename,
                                      unsigned int line, const char* func )
 {
     if ( initialised )
-        fprintf( logfile, "%s, %s (line %u): pass_pointer(@%" PRIXPTR ")\n",
-                 filename, func, line, ( uintptr_t ) p );
+        debug_mem_log_event( LOG_PASS_POINTER, filename, line, func, p, 0, 0 );
     return p;
 }
 
@@ -145,8 +397,8 @@ extern void *debug_mem_return_pointer( void *p, const char* filename,
                                        unsigned int line, const char* func )
 {
     if ( initialised )
-        fprintf( logfile, "%s, %s (line %u): return_pointer(@%" PRIXPTR ")\n",
-                 filename, func, line, ( uintptr_t ) p );
+        debug_mem_log_event( LOG_RETURN_POINTER, filename, line, func, p, 0,
+                             0 );
     return p;
 }
 
@@ -155,10 +407,14 @@ extern void *debug_mem_malloc(
     unsigned int line,    const char* func )
 {
     void* p;
-    if ( table != NULL )
+    if ( table != NULL ) {
+        // no room for the checksum
+        if ( size > SIZE_MAX - sizeof( checksum_t ) )
+            return NULL;
         p = malloc( size + sizeof( checksum_t ) );
-    else
+    } else {
         p = malloc( size );
+    }
     if ( p == NULL ) {
         return NULL;
     }
@@ -166,8 +422,7 @@ extern void *debug_mem_malloc(
         table_set( table, ( uintptr_t ) p, size );
     }
     if ( initialised )
-        fprintf( logfile, "%s, %s (line %u): malloc(%zu) -> @%" PRIXPTR "\n",
-                 filename, func, line, size, ( uintptr_t ) p );
+        debug_mem_log_event( LOG_MALLOC, filename, line, func, p, size, 0 );
     return p;
 }
 
@@ -176,19 +431,22 @@ extern void *debug_mem_calloc(
     const char* filename, unsigned int line, const char* func )
 {
     void *p;
-    if ( table != NULL )
-        p = malloc( ( nmemb * size ) + 1 );
-    else
+    if ( size != 0 && nmemb > SIZE_MAX / size )
+        return NULL;
+    if ( table != NULL ) {
+        // no room for the checksum
+        if ( nmemb * size > SIZE_MAX - sizeof( checksum_t ) )
+            return NULL;
+        p = calloc( ( nmemb * size ) + sizeof( checksum_t ), 1 );
+    } else {
         p = calloc( nmemb, size );
+    }
     if ( p == NULL )
         return NULL;
     if ( table != NULL )
         table_set( table, ( uintptr_t ) p, nmemb * size );
-    if ( initialised ) {
-        fprintf( logfile, "%s, %s (line %u): calloc(%zu, %zu) -> @%"
-                 PRIXPTR "\n", filename, func, line, nmemb, size,
-                 ( uintptr_t ) p );
-    }
+    if ( initialised )
+        debug_mem_log_event( LOG_CALLOC, filename, line, func, p, nmemb, size );
     return p;
 }
 
@@ -199,7 +457,101 @@ extern void debug_mem_free(
     if ( table != NULL )
         table_remove( table, buf );
     if ( initialised )
-        fprintf( logfile, "%s, %s (line %u): free(@%" PRIXPTR ")\n",
-                 filename, func, line, ( uintptr_t ) buf );
+        debug_mem_log_event( LOG_FREE, filename, line, func, buf, 0, 0 );
+    free( buf );
+}
+
+// allocates `count` buffers of `size` bytes into buffers, either all of them
+// are allocated (and tracked) or none are. Table space is reserved once for
+// the whole batch and a single log record, formatted once, records it.
+// return 0: success
+// return 1: allocating or tracking failed, every element of buffers is set
+//           to NULL
+extern int debug_mem_malloc_batch(
+    void **buffers, size_t count, size_t size,
+    const char* filename, unsigned int line, const char* func )
+{
+    size_t allocation_size = size;
+    size_t allocated = 0;
+    bool complete = true;
+    if ( table != NULL ) {
+        // no room for the checksum
+        complete = size <= SIZE_MAX - sizeof( checksum_t );
+        allocation_size += sizeof( checksum_t );
+    }
+    while ( complete && allocated < count ) {
+        buffers[allocated] = malloc( allocation_size );
+        if ( buffers[allocated] == NULL )
+            complete = false;
+        else
+            allocated++;
+    }
+    // every buffer must be tracked as well, otherwise the batch is undone
+    if ( complete && table != NULL
+            && table_set_batch( table, buffers, count, size ) != count ) {
+        table_remove_batch( table, buffers, count );
+        complete = false;
+    }
+    if ( !complete ) {
+        for ( size_t i = 0; i < allocated; i++ )
+            free( buffers[i] );
+        for ( size_t i = 0; i < count; i++ )
+            buffers[i] = NULL;
+        return 1;
+    }
+    if ( initialised )
+        debug_mem_log_batch( LOG_MALLOC_BATCH, filename, line, func, buffers,
+                             count, size );
+    return 0;
+}
+
+extern void debug_mem_free_batch(
+    void **buffers, size_t count,
+    const char* filename, unsigned int line, const char* func )
+{
+    if ( table != NULL )
+        table_remove_batch( table, buffers, count );
+    if ( initialised )
+        debug_mem_log_batch( LOG_FREE_BATCH, filename, line, func, buffers,
+                             count, 0 );
+    for ( size_t i = 0; i < count; i++ )
+        free( buffers[i] );
+}
+
+// as debug_mem_free, but the caller supplies the size of the buffer (as C++
+// sized delete does), and the buffer's checksum is verified on the way out.
+// The check is silent, only a failure adds a second line to the log.
+// return 0: checksum intact, or buf isn't in the table
+// return 1: checksum not correct, or size isn't the size buf was allocated
+//           with (the checksum is still verified against the tracked size)
+extern int debug_mem_free_sized(
+    void *buf, size_t size, const char* filename,
+    unsigned int line, const char* func )
+{
+    int result = 0;
+    size_t tracked_size;
+    if ( initialised )
+        debug_mem_log_event( LOG_FREE_SIZED, filename, line, func, buf, size,
+                             0 );
+    if ( table != NULL && buf != NULL
+            && table_take( table, buf, &tracked_size ) ) {
+        checksum_t checksum = table_checksum( ( uintptr_t ) buf );
+        checksum_t cmp_checksum = debug_mem_stored_checksum( buf, tracked_size );
+        if ( tracked_size != size ) {
+            result = 1;
+            if ( initialised )
+                debug_mem_log( "Freeing buffer @%" PRIXPTR " unsuccessful: "
+                               "given size %zu but %zu bytes were allocated\n",
+                               ( uintptr_t ) buf, size, tracked_size );
+        } else if ( checksum != cmp_checksum ) {
+            result = 1;
+            if ( initialised )
+                debug_mem_log( "Checking buffer @%" PRIXPTR
+                               " unsuccessful: checksum %" PRIXCKSM
+                               " does not match last byte %" PRIXCKSM "\n",
+                               ( uintptr_t ) buf, checksum, cmp_checksum );
+        }
+    }
     free( buf );
+    return result;
 }
@@ -0,0 +1,204 @@
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include "debug_mem.h"
+
+// there is no call site information available to a replacement operator new
+#define DEBUG_MEM_CPP_FILE "c++"
+
+namespace {
+
+void *tracked_new( std::size_t size, const char *func )
+{
+    if ( size == 0 ) // new must return a unique pointer
+        size = 1;
+    for ( ;; ) {
+        void *p = debug_mem_malloc( size, DEBUG_MEM_CPP_FILE, 0, func );
+        if ( p != nullptr )
+            return p;
+        std::new_handler handler = std::get_new_handler();
+        if ( handler == nullptr )
+            throw std::bad_alloc();
+        handler();
+    }
+}
+
+void *tracked_new_nothrow( std::size_t size, const char *func ) noexcept
+{
+    try {
+        return tracked_new( size, func );
+    } catch ( ... ) {
+        return nullptr;
+    }
+}
+
+void tracked_delete( void *p, const char *func ) noexcept
+{
+    if ( p != nullptr )
+        debug_mem_free( p, DEBUG_MEM_CPP_FILE, 0, func );
+}
+
+void tracked_delete_sized( void *p, std::size_t size,
+                           const char *func ) noexcept
+{
+    if ( size == 0 )
+        size = 1;
+    if ( p != nullptr )
+        debug_mem_free_sized( p, size, DEBUG_MEM_CPP_FILE, 0, func );
+}
+
+// Aligned allocations are over-allocated by alignment - 1 bytes plus room for
+// a pointer back to the start of the tracked buffer, which is stored just
+// before the aligned address. The size of the tracked buffer can then be
+// recovered from the requested size for sized delete.
+inline std::size_t aligned_total( std::size_t size, std::align_val_t al )
+{
+    return ( size ? size : 1 ) + static_cast<std::size_t>( al ) - 1
+           + sizeof( void * );
+}
+
+void *tracked_new_aligned( std::size_t size, std::align_val_t al,
+                           const char *func )
+{
+    std::size_t alignment = static_cast<std::size_t>( al );
+    if ( size > SIZE_MAX - alignment - sizeof( void * ) )
+        throw std::bad_alloc();
+    void *base = tracked_new( aligned_total( size, al ), func );
+    std::uintptr_t aligned =
+        ( reinterpret_cast<std::uintptr_t>( base ) + sizeof( void * )
+          + alignment - 1 ) & ~( static_cast<std::uintptr_t>( alignment ) - 1 );
+    reinterpret_cast<void **>( aligned )[-1] = base;
+    return reinterpret_cast<void *>( aligned );
+}
+
+void *tracked_new_aligned_nothrow( std::size_t size, std::align_val_t al,
+                                   const char *func ) noexcept
+{
+    try {
+        return tracked_new_aligned( size, al, func );
+    } catch ( ... ) {
+        return nullptr;
+    }
+}
+
+void tracked_delete_aligned( void *p, const char *func ) noexcept
+{
+    if ( p != nullptr )
+        tracked_delete( static_cast<void **>( p )[-1], func );
+}
+
+void tracked_delete_aligned_sized( void *p, std::size_t size,
+                                   std::align_val_t al,
+                                   const char *func ) noexcept
+{
+    if ( p != nullptr )
+        tracked_delete_sized( static_cast<void **>( p )[-1],
+                              aligned_total( size, al ), func );
+}
+
+} // namespace
+
+void *operator new( std::size_t size )
+{
+    return tracked_new( size, "operator new" );
+}
+
+void *operator new[]( std::size_t size )
+{
+    return tracked_new( size, "operator new[]" );
+}
+
+void *operator new( std::size_t size, const std::nothrow_t& ) noexcept
+{
+    return tracked_new_nothrow( size, "operator new" );
+}
+
+void *operator new[]( std::size_t size, const std::nothrow_t& ) noexcept
+{
+    return tracked_new_nothrow( size, "operator new[]" );
+}
+
+void *operator new( std::size_t size, std::align_val_t al )
+{
+    return tracked_new_aligned( size, al, "operator new" );
+}
+
+void *operator new[]( std::size_t size, std::align_val_t al )
+{
+    return tracked_new_aligned( size, al, "operator new[]" );
+}
+
+void *operator new( std::size_t size, std::align_val_t al,
+                    const std::nothrow_t& ) noexcept
+{
+    return tracked_new_aligned_nothrow( size, al, "operator new" );
+}
+
+void *operator new[]( std::size_t size, std::align_val_t al,
+                      const std::nothrow_t& ) noexcept
+{
+    return tracked_new_aligned_nothrow( size, al, "operator new[]" );
+}
+
+void operator delete( void *p ) noexcept
+{
+    tracked_delete( p, "operator delete" );
+}
+
+void operator delete[]( void *p ) noexcept
+{
+    tracked_delete( p, "operator delete[]" );
+}
+
+void operator delete( void *p, std::size_t size ) noexcept
+{
+    tracked_delete_sized( p, size, "operator delete" );
+}
+
+void operator delete[]( void *p, std::size_t size ) noexcept
+{
+    tracked_delete_sized( p, size, "operator delete[]" );
+}
+
+void operator delete( void *p, const std::nothrow_t& ) noexcept
+{
+    tracked_delete( p, "operator delete" );
+}
+
+void operator delete[]( void *p, const std::nothrow_t& ) noexcept
+{
+    tracked_delete( p, "operator delete[]" );
+}
+
+void operator delete( void *p, std::align_val_t ) noexcept
+{
+    tracked_delete_aligned( p, "operator delete" );
+}
+
+void operator delete[]( void *p, std::align_val_t ) noexcept
+{
+    tracked_delete_aligned( p, "operator delete[]" );
+}
+
+void operator delete( void *p, std::size_t size, std::align_val_t al ) noexcept
+{
+    tracked_delete_aligned_sized( p, size, al, "operator delete" );
+}
+
+void operator delete[]( void *p, std::size_t size,
+                        std::align_val_t al ) noexcept
+{
+    tracked_delete_aligned_sized( p, size, al, "operator delete[]" );
+}
+
+void operator delete( void *p, std::align_val_t,
+                      const std::nothrow_t& ) noexcept
+{
+    tracked_delete_aligned( p, "operator delete" );
+}
+
+void operator delete[]( void *p, std::align_val_t,
+                        const std::nothrow_t& ) noexcept
+{
+    tracked_delete_aligned( p, "operator delete[]" );
+}
@@ -0,0 +1,784 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <inttypes.h>
+#include "log_compress.h"
+
+// A small LZ77 variant, each block is a series of sequences:
+//   varint(literal count) <literals> varint(match length) varint(offset)
+// the final sequence of a block has no match part. It runs over the binary
+// records (below), picking up what the record encoding leaves, such as
+// repeated (site, size) pairs and text lines. Positions inside a match are
+// not added to the hash table, which is both faster and compresses better
+// than letting every byte of a long repeat evict older candidates.
+#define LZ_HASH_BITS 12
+#define LZ_MIN_MATCH 4
+// after 2^LZ_SKIP_SHIFT positions without a match the search starts stepping
+// over more than one byte at a time, so incompressible stretches are cheap
+#define LZ_SKIP_SHIFT 4
+
+static size_t varint_put( unsigned char *out, size_t value )
+{
+    size_t n = 0;
+    while ( value >= 0x80 ) {
+        out[n++] = ( unsigned char )( ( value & 0x7F ) | 0x80 );
+        value >>= 7;
+    }
+    out[n++] = ( unsigned char ) value;
+    return n;
+}
+
+static size_t varint_size( size_t value )
+{
+    size_t n = 1;
+    while ( value >= 0x80 ) {
+        value >>= 7;
+        n++;
+    }
+    return n;
+}
+
+static bool varint_get( const unsigned char **pin, const unsigned char *end,
+                        size_t *value )
+{
+    const unsigned char *in = *pin;
+    size_t result = 0;
+    for ( unsigned int shift = 0; in < end && shift < 64; shift += 7 ) {
+        unsigned char byte = *in++;
+        result |= ( size_t )( byte & 0x7F ) << shift;
+        if ( !( byte & 0x80 ) ) {
+            *value = result;
+            *pin = in;
+            return true;
+        }
+    }
+    return false;
+}
+
+static inline uint32_t lz_read32( const unsigned char *p )
+{
+    uint32_t v;
+    memcpy( &v, p, sizeof( v ) );
+    return v;
+}
+
+static inline size_t lz_hash( const unsigned char *p )
+{
+    return ( size_t )( ( lz_read32( p ) * 2654435761u )
+                       >> ( 32 - LZ_HASH_BITS ) );
+}
+
+// number of equal bytes at a and b, b being the later position
+static inline size_t lz_match_length( const unsigned char *a,
+                                      const unsigned char *b,
+                                      const unsigned char *end )
+{
+    const unsigned char *start = b;
+    while ( b + sizeof( uint64_t ) <= end ) {
+        uint64_t x, y;
+        memcpy( &x, a, sizeof( x ) );
+        memcpy( &y, b, sizeof( y ) );
+        if ( x != y )
+            break;
+        a += sizeof( x );
+        b += sizeof( y );
+    }
+    while ( b < end && *a == *b ) {
+        a++;
+        b++;
+    }
+    return ( size_t )( b - start );
+}
+
+// compress in_length (<= LOG_COMPRESS_BLOCK_SIZE) bytes into out, which must
+// have room for LOG_COMPRESS_BOUND(in_length) bytes, returns bytes written
+extern size_t log_compress_block( const unsigned char *in, size_t in_length,
+                                  unsigned char *out )
+{
+    uint32_t heads[1 << LZ_HASH_BITS] = { 0 };
+    size_t ip = 0, anchor = 0, op = 0;
+    size_t misses = 0;
+    while ( ip + LZ_MIN_MATCH <= in_length ) {
+        size_t h = lz_hash( &in[ip] );
+        size_t candidate = heads[h];
+        heads[h] = ( uint32_t )( ip + 1 );
+        if ( candidate == 0
+                || lz_read32( &in[candidate - 1] ) != lz_read32( &in[ip] ) ) {
+            ip += 1 + ( misses++ >> LZ_SKIP_SHIFT );
+            continue;
+        }
+        candidate--;
+        size_t length = LZ_MIN_MATCH
+                        + lz_match_length( &in[candidate + LZ_MIN_MATCH],
+                                           &in[ip + LZ_MIN_MATCH],
+                                           &in[in_length] );
+        size_t offset = ip - candidate;
+        if ( varint_size( length ) + varint_size( offset ) >= length ) {
+            ip += 1 + ( misses++ >> LZ_SKIP_SHIFT );
+            continue;
+        }
+        misses = 0;
+        op += varint_put( &out[op], ip - anchor );
+        memcpy( &out[op], &in[anchor], ip - anchor );
+        op += ip - anchor;
+        op += varint_put( &out[op], length );
+        op += varint_put( &out[op], offset );
+        ip += length;
+        // the end of a match is likely to be the start of the next one
+        if ( ip - 2 + LZ_MIN_MATCH <= in_length )
+            heads[lz_hash( &in[ip - 2] )] = ( uint32_t )( ip - 1 );
+        anchor = ip;
+    }
+    op += varint_put( &out[op], in_length - anchor );
+    memcpy( &out[op], &in[anchor], in_length - anchor );
+    op += in_length - anchor;
+    return op;
+}
+
+// returns false if the block is corrupt or does not decode to exactly
+// out_length bytes
+extern bool log_decompress_block( const unsigned char *in, size_t in_length,
+                                  unsigned char *out, size_t out_length )
+{
+    const unsigned char *end = in + in_length;
+    size_t op = 0;
+    for ( ;; ) {
+        size_t literals, length, offset;
+        if ( !varint_get( &in, end, &literals ) )
+            return false;
+        if ( literals > ( size_t )( end - in ) || literals > out_length - op )
+            return false;
+        memcpy( &out[op], in, literals );
+        in += literals;
+        op += literals;
+        if ( in == end )
+            return op == out_length;
+        if ( !varint_get( &in, end, &length )
+                || !varint_get( &in, end, &offset ) )
+            return false;
+        if ( offset == 0 || offset > op || length > out_length - op )
+            return false;
+        // byte by byte, matches may overlap their own output
+        for ( size_t i = 0; i < length; i++, op++ )
+            out[op] = out[op - offset];
+    }
+}
+
+extern bool log_write_header( FILE *file )
+{
+    const char header[] = LOG_COMPRESS_MAGIC;
+    return fwrite( header, 1, sizeof( header ) - 1, file ) == sizeof( header ) - 1
+           && fputc( LOG_COMPRESS_VERSION, file ) != EOF;
+}
+
+// scratch must have room for LOG_COMPRESS_BOUND(raw_length) bytes
+extern bool log_write_block( FILE *file, const unsigned char *raw,
+                             size_t raw_length, unsigned char *scratch )
+{
+    unsigned char lengths[20];
+    size_t compressed_length = log_compress_block( raw, raw_length, scratch );
+    size_t n = varint_put( lengths, raw_length );
+    n += varint_put( &lengths[n], compressed_length );
+    return fwrite( lengths, 1, n, file ) == n
+           && fwrite( scratch, 1, compressed_length, file ) == compressed_length;
+}
+
+
+// zigzag encoding of the difference between consecutive addresses, so that a
+// small step in either direction is a small number
+static inline size_t log_address_delta( uintptr_t *last, uintptr_t address )
+{
+    uintptr_t delta = address - *last;
+    *last = address;
+    return ( size_t )( ( delta << 1 )
+                       ^ ( ( uintptr_t ) 0 - ( delta >> ( sizeof( delta ) * 8
+                                                           - 1 ) ) ) );
+}
+
+static inline uintptr_t log_address_undelta( uintptr_t *last, size_t value )
+{
+    uintptr_t zigzag = ( uintptr_t ) value;
+    *last += ( zigzag >> 1 ) ^ ( ( uintptr_t ) 0 - ( zigzag & 1 ) );
+    return *last;
+}
+
+static inline size_t log_mix( uint64_t x )
+{
+    // splitmix64 finaliser
+    x = ( x ^ ( x >> 30 ) ) * 0xBF58476D1CE4E5B9ULL;
+    x = ( x ^ ( x >> 27 ) ) * 0x94D049BB133111EBULL;
+    return ( size_t )( x ^ ( x >> 31 ) );
+}
+
+// Names and call sites are looked up by the pointers they were logged with,
+// __FILE__ and __func__ give the same pointer every time a call site is
+// reached, so no string is compared or hashed by content. Strings are keyed
+// on (string, NULL, 0), call sites on (file, func, line)
+typedef struct {
+    const char *a;
+    const char *b;
+    unsigned int line;
+    size_t id;
+} LogMapEntry;
+
+typedef struct {
+    LogMapEntry *entries; // a == NULL marks an empty slot
+    size_t capacity;
+    size_t length;
+} LogMap;
+
+static inline size_t log_map_home( const LogMap *map, const char *a,
+                                   const char *b, unsigned int line )
+{
+    return log_mix( ( uint64_t )( uintptr_t ) a
+                    ^ log_mix( ( uint64_t )( uintptr_t ) b + line ) )
+           & ( map->capacity - 1 );
+}
+
+static bool log_map_find( const LogMap *map, const char *a, const char *b,
+                          unsigned int line, size_t *id )
+{
+    if ( map->capacity == 0 )
+        return false;
+    for ( size_t i = log_map_home( map, a, b, line ); map->entries[i].a != NULL;
+            i = ( i + 1 ) & ( map->capacity - 1 ) ) {
+        LogMapEntry *entry = &map->entries[i];
+        if ( entry->a == a && entry->b == b && entry->line == line ) {
+            *id = entry->id;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void log_map_insert( LogMap *map, LogMapEntry entry )
+{
+    size_t i = log_map_home( map, entry.a, entry.b, entry.line );
+    while ( map->entries[i].a != NULL )
+        i = ( i + 1 ) & ( map->capacity - 1 );
+    map->entries[i] = entry;
+    map->length++;
+}
+
+// if the map can't grow the entry is left out, it is then defined again the
+// next time it is logged, which costs space but is still a valid log
+static void log_map_add( LogMap *map, const char *a, const char *b,
+                         unsigned int line, size_t id )
+{
+    if ( ( map->length + 1 ) * 2 > map->capacity ) {
+        LogMap grown = { NULL, map->capacity ? map->capacity * 2 : 64, 0 };
+        grown.entries = calloc( grown.capacity, sizeof( LogMapEntry ) );
+        if ( grown.entries == NULL )
+            return;
+        for ( size_t i = 0; i < map->capacity; i++ ) {
+            if ( map->entries[i].a != NULL )
+                log_map_insert( &grown, map->entries[i] );
+        }
+        free( map->entries );
+        *map = grown;
+    }
+    LogMapEntry entry = { a, b, line, id };
+    log_map_insert( map, entry );
+}
+
+struct LogWriter {
+    FILE *file;
+    // raw bytes of the block being filled, and room to compress it into
+    unsigned char *block;
+    unsigned char *scratch;
+    size_t block_length;
+    bool failed;
+    uintptr_t last_address;
+    LogMap strings;
+    LogMap sites;
+    size_t n_strings;
+    size_t n_sites;
+};
+
+static void log_writer_flush( LogWriter* writer )
+{
+    if ( writer->block_length > 0 ) {
+        if ( !log_write_block( writer->file, writer->block,
+                               writer->block_length, writer->scratch ) )
+            writer->failed = true;
+        writer->block_length = 0;
+    }
+}
+
+// records may continue from one block into the next
+static void log_put( LogWriter* writer, const void *data, size_t length )
+{
+    const unsigned char *bytes = data;
+    while ( length > 0 ) {
+        if ( writer->block_length == LOG_COMPRESS_BLOCK_SIZE )
+            log_writer_flush( writer );
+        size_t room = LOG_COMPRESS_BLOCK_SIZE - writer->block_length;
+        size_t n = length < room ? length : room;
+        memcpy( &writer->block[writer->block_length], bytes, n );
+        writer->block_length += n;
+        bytes += n;
+        length -= n;
+    }
+}
+
+// writes the header, returns NULL if that or allocating the writer fails
+extern LogWriter* log_writer_open( FILE *file )
+{
+    LogWriter* writer = calloc( 1, sizeof( LogWriter ) );
+    if ( writer == NULL )
+        return NULL;
+    writer->file = file;
+    writer->block = malloc( LOG_COMPRESS_BLOCK_SIZE );
+    writer->scratch = malloc( LOG_COMPRESS_BOUND( LOG_COMPRESS_BLOCK_SIZE ) );
+    if ( writer->block == NULL || writer->scratch == NULL
+            || !log_write_header( file ) ) {
+        free( writer->block );
+        free( writer->scratch );
+        free( writer );
+        return NULL;
+    }
+    return writer;
+}
+
+// writes out the last (partial) block and frees the writer, but doesn't close
+// its file. Returns false if any block failed to be written
+extern bool log_writer_close( LogWriter* writer )
+{
+    log_writer_flush( writer );
+    bool written = !writer->failed;
+    free( writer->block );
+    free( writer->scratch );
+    free( writer->strings.entries );
+    free( writer->sites.entries );
+    free( writer );
+    return written;
+}
+
+static size_t log_string_id( LogWriter* writer, const char *string )
+{
+    size_t id;
+    if ( log_map_find( &writer->strings, string, NULL, 0, &id ) )
+        return id;
+    size_t length = strlen( string );
+    unsigned char record[1 + 10];
+    size_t n = 0;
+    record[n++] = LOG_RECORD_STRING;
+    n += varint_put( &record[n], length );
+    log_put( writer, record, n );
+    log_put( writer, string, length );
+    id = writer->n_strings++;
+    log_map_add( &writer->strings, string, NULL, 0, id );
+    return id;
+}
+
+static size_t log_site_id( LogWriter* writer, const char *file,
+                           unsigned int line, const char *func )
+{
+    size_t id;
+    if ( file == NULL )
+        file = "(null)";
+    if ( func == NULL )
+        func = "(null)";
+    if ( log_map_find( &writer->sites, file, func, line, &id ) )
+        return id;
+    size_t file_id = log_string_id( writer, file );
+    size_t func_id = log_string_id( writer, func );
+    unsigned char record[1 + 3 * 10];
+    size_t n = 0;
+    record[n++] = LOG_RECORD_SITE;
+    n += varint_put( &record[n], file_id );
+    n += varint_put( &record[n], func_id );
+    n += varint_put( &record[n], line );
+    log_put( writer, record, n );
+    id = writer->n_sites++;
+    log_map_add( &writer->sites, file, func, line, id );
+    return id;
+}
+
+// a line which isn't one of the events, logged as it would be in the text log
+extern void log_record_text( LogWriter* writer, const char *text,
+                             size_t length )
+{
+    unsigned char record[1 + 10];
+    size_t n = 0;
+    record[n++] = LOG_RECORD_TEXT;
+    n += varint_put( &record[n], length );
+    log_put( writer, record, n );
+    log_put( writer, text, length );
+}
+
+// any event except the batches, a and b are its sizes in the order they
+// appear in the record (see LogEvent), unused ones are ignored
+extern void log_record_event( LogWriter* writer, LogEvent event,
+                              const char *file, unsigned int line,
+                              const char *func, uintptr_t address,
+                              size_t a, size_t b )
+{
+    size_t site = log_site_id( writer, file, line, func );
+    unsigned char record[1 + 4 * 10];
+    size_t n = 0;
+    record[n++] = ( unsigned char )( LOG_RECORD_EVENT + event );
+    n += varint_put( &record[n], site );
+    n += varint_put( &record[n],
+                     log_address_delta( &writer->last_address, address ) );
+    if ( event == LOG_MALLOC || event == LOG_FREE_SIZED ) {
+        n += varint_put( &record[n], a );
+    } else if ( event == LOG_CALLOC ) {
+        n += varint_put( &record[n], a );
+        n += varint_put( &record[n], b );
+    }
+    log_put( writer, record, n );
+}
+
+// LOG_MALLOC_BATCH or LOG_FREE_BATCH, size is ignored for the latter
+extern void log_record_batch( LogWriter* writer, LogEvent event,
+                              const char *file, unsigned int line,
+                              const char *func, void *const *addresses,
+                              size_t count, size_t size )
+{
+    size_t site = log_site_id( writer, file, line, func );
+    unsigned char record[256];
+    size_t n = 0;
+    record[n++] = ( unsigned char )( LOG_RECORD_EVENT + event );
+    n += varint_put( &record[n], site );
+    n += varint_put( &record[n], count );
+    if ( event == LOG_MALLOC_BATCH )
+        n += varint_put( &record[n], size );
+    for ( size_t i = 0; i < count; i++ ) {
+        if ( n > sizeof( record ) - 10 ) {
+            log_put( writer, record, n );
+            n = 0;
+        }
+        n += varint_put( &record[n],
+                         log_address_delta( &writer->last_address,
+                                            ( uintptr_t ) addresses[i] ) );
+    }
+    log_put( writer, record, n );
+}
+
+// the lines of the text log, shared by the plain log and the decompressor
+extern void log_render_event( FILE *out, LogEvent event, const char *file,
+                              unsigned int line, const char *func,
+                              uintptr_t address, size_t a, size_t b )
+{
+    switch ( event ) {
+    case LOG_MALLOC:
+        fprintf( out, "%s, %s (line %u): malloc(%zu) -> @%" PRIXPTR "\n",
+                 file, func, line, a, address );
+        break;
+    case LOG_CALLOC:
+        fprintf( out, "%s, %s (line %u): calloc(%zu, %zu) -> @%" PRIXPTR "\n",
+                 file, func, line, a, b, address );
+        break;
+    case LOG_FREE:
+        fprintf( out, "%s, %s (line %u): free(@%" PRIXPTR ")\n",
+                 file, func, line, address );
+        break;
+    case LOG_FREE_SIZED:
+        fprintf( out, "%s, %s (line %u): free_sized(@%" PRIXPTR ", %zu)\n",
+                 file, func, line, address, a );
+        break;
+    case LOG_PASS_POINTER:
+        fprintf( out, "%s, %s (line %u): pass_pointer(@%" PRIXPTR ")\n",
+                 file, func, line, address );
+        break;
+    case LOG_RETURN_POINTER:
+        fprintf( out, "%s, %s (line %u): return_pointer(@%" PRIXPTR ")\n",
+                 file, func, line, address );
+        break;
+    default: // batches go through log_render_batch
+        break;
+    }
+}
+
+// upper case hex without leading zeros, as PRIXPTR prints it
+static size_t log_hex( char *out, uintptr_t value )
+{
+    char digits[2 * sizeof( uintptr_t )];
+    size_t n = 0;
+    do {
+        digits[n++] = "0123456789ABCDEF"[value & 0xF];
+        value >>= 4;
+    } while ( value != 0 );
+    for ( size_t i = 0; i < n; i++ )
+        out[i] = digits[n - 1 - i];
+    return n;
+}
+
+// the addresses are formatted into one buffer and written with a single call
+// rather than a printf per address
+extern void log_render_batch( FILE *out, LogEvent event, const char *file,
+                              unsigned int line, const char *func,
+                              void *const *addresses, size_t count,
+                              size_t size )
+{
+    if ( event == LOG_MALLOC_BATCH )
+        fprintf( out, "%s, %s (line %u): malloc_batch(%zu, %zu) ->",
+                 file, func, line, count, size );
+    else
+        fprintf( out, "%s, %s (line %u): free_batch(%zu) <-",
+                 file, func, line, count );
+    // " @" and the digits of each address, then the newline
+    const size_t per_address = 2 + 2 * sizeof( uintptr_t );
+    char *text = NULL;
+    if ( count < ( SIZE_MAX - 1 ) / per_address )
+        text = malloc( count * per_address + 1 );
+    if ( text == NULL ) {
+        for ( size_t i = 0; i < count; i++ )
+            fprintf( out, " @%" PRIXPTR, ( uintptr_t ) addresses[i] );
+        fputc( '\n', out );
+        return;
+    }
+    size_t n = 0;
+    for ( size_t i = 0; i < count; i++ ) {
+        text[n++] = ' ';
+        text[n++] = '@';
+        n += log_hex( &text[n], ( uintptr_t ) addresses[i] );
+    }
+    text[n++] = '\n';
+    fwrite( text, 1, n, out );
+    free( text );
+}
+
+typedef struct {
+    size_t file;
+    size_t func;
+    unsigned int line;
+} LogSiteDef;
+
+// state carried from one record to the next while rendering
+typedef struct {
+    char **strings;
+    size_t n_strings;
+    size_t max_strings;
+    LogSiteDef *sites;
+    size_t n_sites;
+    size_t max_sites;
+    uintptr_t last_address;
+    void **addresses; // scratch for batch records
+    size_t max_addresses;
+} LogReader;
+
+static void log_reader_destroy( LogReader* reader )
+{
+    for ( size_t i = 0; i < reader->n_strings; i++ )
+        free( reader->strings[i] );
+    free( reader->strings );
+    free( reader->sites );
+    free( reader->addresses );
+}
+
+// make room for at least n elements of element_size in *array
+static bool log_reserve( void **array, size_t *capacity, size_t n,
+                         size_t element_size )
+{
+    if ( *array != NULL && n <= *capacity )
+        return true;
+    size_t new_capacity = *capacity ? *capacity : 64;
+    while ( new_capacity < n )
+        new_capacity *= 2;
+    if ( new_capacity > SIZE_MAX / element_size )
+        return false;
+    void *grown = realloc( *array, new_capacity * element_size );
+    if ( grown == NULL )
+        return false;
+    *array = grown;
+    *capacity = new_capacity;
+    return true;
+}
+
+// renders the record at *pin, moving *pin past it.
+// return 1: record rendered
+// return 0: the record continues past end
+// return -1: the record is corrupt
+// return -2: out of memory
+static int log_render_record( LogReader* reader, const unsigned char **pin,
+                              const unsigned char *end, FILE *out )
+{
+    const unsigned char *in = *pin;
+    if ( in == end )
+        return 0;
+    unsigned int tag = *in++;
+    size_t fields[3];
+    if ( tag == LOG_RECORD_STRING || tag == LOG_RECORD_TEXT ) {
+        if ( !varint_get( &in, end, &fields[0] ) )
+            return 0;
+        if ( fields[0] > ( size_t )( end - in ) )
+            return 0;
+        if ( tag == LOG_RECORD_TEXT ) {
+            fwrite( in, 1, fields[0], out );
+        } else {
+            char *string = malloc( fields[0] + 1 );
+            if ( string == NULL
+                    || !log_reserve( ( void ** ) &reader->strings,
+                                     &reader->max_strings,
+                                     reader->n_strings + 1, sizeof( char * ) ) ) {
+                free( string );
+                return -2;
+            }
+            memcpy( string, in, fields[0] );
+            string[fields[0]] = '\0';
+            reader->strings[reader->n_strings++] = string;
+        }
+        *pin = in + fields[0];
+        return 1;
+    }
+    if ( tag == LOG_RECORD_SITE ) {
+        for ( size_t i = 0; i < 3; i++ ) {
+            if ( !varint_get( &in, end, &fields[i] ) )
+                return 0;
+        }
+        if ( fields[0] >= reader->n_strings || fields[1] >= reader->n_strings
+                || fields[2] > UINT32_MAX )
+            return -1;
+        if ( !log_reserve( ( void ** ) &reader->sites, &reader->max_sites,
+                           reader->n_sites + 1, sizeof( LogSiteDef ) ) )
+            return -2;
+        LogSiteDef site = { fields[0], fields[1], ( unsigned int ) fields[2] };
+        reader->sites[reader->n_sites++] = site;
+        *pin = in;
+        return 1;
+    }
+    if ( tag < LOG_RECORD_EVENT || tag >= LOG_RECORD_EVENT + LOG_EVENTS )
+        return -1;
+    LogEvent event = ( LogEvent )( tag - LOG_RECORD_EVENT );
+    size_t site_id, value;
+    if ( !varint_get( &in, end, &site_id ) )
+        return 0;
+    if ( site_id >= reader->n_sites )
+        return -1;
+    LogSiteDef *site = &reader->sites[site_id];
+    const char *file = reader->strings[site->file];
+    const char *func = reader->strings[site->func];
+    // addresses are only committed once the whole record is known to be here
+    uintptr_t last = reader->last_address;
+    if ( event == LOG_MALLOC_BATCH || event == LOG_FREE_BATCH ) {
+        size_t count, size = 0;
+        if ( !varint_get( &in, end, &count ) )
+            return 0;
+        if ( event == LOG_MALLOC_BATCH && !varint_get( &in, end, &size ) )
+            return 0;
+        // every address takes at least a byte
+        if ( count > ( size_t )( end - in ) )
+            return 0;
+        if ( !log_reserve( ( void ** ) &reader->addresses,
+                           &reader->max_addresses, count, sizeof( void * ) ) )
+            return -2;
+        for ( size_t i = 0; i < count; i++ ) {
+            if ( !varint_get( &in, end, &value ) )
+                return 0;
+            reader->addresses[i] = ( void * ) log_address_undelta( &last,
+                                                                   value );
+        }
+        log_render_batch( out, event, file, site->line, func,
+                          reader->addresses, count, size );
+    } else {
+        size_t n_fields = event == LOG_CALLOC ? 2
+                          : event == LOG_MALLOC || event == LOG_FREE_SIZED;
+        fields[0] = fields[1] = 0;
+        if ( !varint_get( &in, end, &value ) )
+            return 0;
+        for ( size_t i = 0; i < n_fields; i++ ) {
+            if ( !varint_get( &in, end, &fields[i] ) )
+                return 0;
+        }
+        log_render_event( out, event, file, site->line, func,
+                          log_address_undelta( &last, value ),
+                          fields[0], fields[1] );
+    }
+    reader->last_address = last;
+    *pin = in;
+    return 1;
+}
+
+static bool varint_read( FILE *file, size_t *value, bool *at_eof )
+{
+    size_t result = 0;
+    for ( unsigned int shift = 0; shift < 64; shift += 7 ) {
+        int c = fgetc( file );
+        if ( c == EOF ) {
+            *at_eof = ( shift == 0 );
+            return false;
+        }
+        result |= ( size_t )( c & 0x7F ) << shift;
+        if ( !( c & 0x80 ) ) {
+            *value = result;
+            return true;
+        }
+    }
+    *at_eof = false;
+    return false;
+}
+
+// return 0: whole stream decompressed and rendered as text
+// return 1: not a compressed log
+// return 2: stream is truncated or corrupt (complete records are still written)
+// return 3: out of memory or failed to write output
+extern int log_decompress_stream( FILE *in, FILE *out )
+{
+    char header[sizeof( LOG_COMPRESS_MAGIC )];
+    if ( fread( header, 1, sizeof( header ), in ) != sizeof( header )
+            || memcmp( header, LOG_COMPRESS_MAGIC, sizeof( header ) - 1 ) != 0
+            || header[sizeof( header ) - 1] != LOG_COMPRESS_VERSION )
+        return 1;
+    unsigned char *compressed =
+        malloc( LOG_COMPRESS_BOUND( LOG_COMPRESS_BLOCK_SIZE ) );
+    // decompressed bytes not yet rendered, a record may span several blocks
+    unsigned char *pending = NULL;
+    size_t pending_length = 0, pending_capacity = 0;
+    LogReader reader = { 0 };
+    int status = 0;
+    if ( compressed == NULL ) {
+        status = 3;
+    }
+    while ( status == 0 ) {
+        size_t raw_length, compressed_length;
+        bool at_eof = false;
+        if ( !varint_read( in, &raw_length, &at_eof ) ) {
+            if ( !at_eof )
+                status = 2;
+            break;
+        }
+        if ( !varint_read( in, &compressed_length, &at_eof )
+                || raw_length > LOG_COMPRESS_BLOCK_SIZE
+                || compressed_length > LOG_COMPRESS_BOUND( raw_length )
+                || fread( compressed, 1, compressed_length, in )
+                   != compressed_length ) {
+            status = 2;
+            break;
+        }
+        if ( !log_reserve( ( void ** ) &pending, &pending_capacity,
+                           pending_length + raw_length, 1 ) ) {
+            status = 3;
+            break;
+        }
+        if ( !log_decompress_block( compressed, compressed_length,
+                                    &pending[pending_length], raw_length ) ) {
+            status = 2;
+            break;
+        }
+        pending_length += raw_length;
+        const unsigned char *next = pending;
+        int rendered;
+        do {
+            rendered = log_render_record( &reader, &next,
+                                          &pending[pending_length], out );
+        } while ( rendered == 1 );
+        if ( rendered < 0 )
+            status = rendered == -1 ? 2 : 3;
+        pending_length -= ( size_t )( next - pending );
+        memmove( pending, next, pending_length );
+    }
+    // the stream ended part way through a record
+    if ( status == 0 && pending_length > 0 )
+        status = 2;
+    if ( status == 0 && ferror( out ) )
+        status = 3;
+    log_reader_destroy( &reader );
+    free( pending );
+    free( compressed );
+    return status;
+}
@@ -0,0 +1,209 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "mem_domain.h"
+
+// An open addressing map from location to the location's domain and its
+// neighbours on that domain's list. The lists link locations rather than
+// slots, so entries can move (when the map is resized, or shifted back after
+// a removal) without the lists being touched. Location 0 marks an empty slot
+// and the end of a list
+typedef struct {
+    uintptr_t location;
+    uintptr_t prev;
+    uintptr_t next;
+    unsigned int domain;
+} MemDomainEntry;
+
+#define DOMAIN_MIN_CAPACITY 16
+// same load limits as the allocation table
+#define DOMAIN_MAX_LENGTH( capacity ) ( ( capacity ) * 3 / 4 )
+
+struct MemDomains {
+    MemDomainEntry *entries;
+    size_t capacity;
+    size_t length;
+    uintptr_t heads[DOMAIN_MAX];
+    size_t lengths[DOMAIN_MAX];
+};
+
+static inline size_t domain_home( uintptr_t location, size_t capacity )
+{
+    // splitmix64 finaliser
+    uint64_t x = ( uint64_t ) location;
+    x = ( x ^ ( x >> 30 ) ) * 0xBF58476D1CE4E5B9ULL;
+    x = ( x ^ ( x >> 27 ) ) * 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    return ( size_t )( x % capacity );
+}
+
+// entry for location, or NULL if it isn't in a domain
+static MemDomainEntry *domain_entry( MemDomains* domains, uintptr_t location )
+{
+    if ( location == 0 )
+        return NULL;
+    size_t index = domain_home( location, domains->capacity );
+    while ( domains->entries[index].location != 0 ) {
+        if ( domains->entries[index].location == location )
+            return &domains->entries[index];
+        if ( ++index >= domains->capacity )
+            index = 0;
+    }
+    return NULL;
+}
+
+static MemDomainEntry *domain_place( MemDomainEntry *entries, size_t capacity,
+                                     uintptr_t location )
+{
+    size_t index = domain_home( location, capacity );
+    while ( entries[index].location != 0 ) {
+        if ( ++index >= capacity )
+            index = 0;
+    }
+    return &entries[index];
+}
+
+static bool domain_resize( MemDomains* domains, size_t new_capacity )
+{
+    MemDomainEntry *entries = calloc( new_capacity, sizeof( MemDomainEntry ) );
+    if ( entries == NULL )
+        return false;
+    for ( size_t i = 0; i < domains->capacity; i++ ) {
+        MemDomainEntry *entry = &domains->entries[i];
+        if ( entry->location != 0 )
+            *domain_place( entries, new_capacity, entry->location ) = *entry;
+    }
+    free( domains->entries );
+    domains->entries = entries;
+    domains->capacity = new_capacity;
+    return true;
+}
+
+extern MemDomains* domain_init()
+{
+    MemDomains* domains = malloc( sizeof( MemDomains ) );
+    if ( domains == NULL )
+        return NULL;
+    domains->capacity = DOMAIN_MIN_CAPACITY;
+    domains->length = 0;
+    domains->entries = calloc( domains->capacity, sizeof( MemDomainEntry ) );
+    if ( domains->entries == NULL ) {
+        free( domains );
+        return NULL;
+    }
+    for ( size_t i = 0; i < DOMAIN_MAX; i++ ) {
+        domains->heads[i] = 0;
+        domains->lengths[i] = 0;
+    }
+    return domains;
+}
+
+extern void domain_destroy( MemDomains* domains )
+{
+    free( domains->entries );
+    free( domains );
+}
+
+// adds location (which must not be 0) to the front of domain's list, moving
+// it there if it was in another domain. Domain 0 has no list, so inserting
+// into it is the same as domain_remove. Returns false if out of memory
+extern bool domain_insert( MemDomains* domains, uintptr_t location,
+                           unsigned int domain )
+{
+    domain_remove( domains, location );
+    if ( domain == 0 || domain >= DOMAIN_MAX )
+        return domain == 0;
+    if ( domains->length >= DOMAIN_MAX_LENGTH( domains->capacity )
+            && !domain_resize( domains, domains->capacity * 2 ) )
+        return false;
+    MemDomainEntry *entry = domain_place( domains->entries, domains->capacity,
+                                          location );
+    entry->location = location;
+    entry->prev = 0;
+    entry->next = domains->heads[domain];
+    entry->domain = domain;
+    if ( entry->next != 0 )
+        domain_entry( domains, entry->next )->prev = location;
+    domains->heads[domain] = location;
+    domains->lengths[domain]++;
+    domains->length++;
+    return true;
+}
+
+// takes location off its domain's list, returns false if it wasn't in a
+// domain other than 0.
+// entries after the removed one are shifted back into the gap (as far as
+// their home slot allows) so that lookups can stop at the first empty slot
+extern bool domain_remove( MemDomains* domains, uintptr_t location )
+{
+    MemDomainEntry *entry = domain_entry( domains, location );
+    if ( entry == NULL )
+        return false;
+    if ( entry->prev != 0 )
+        domain_entry( domains, entry->prev )->next = entry->next;
+    else
+        domains->heads[entry->domain] = entry->next;
+    if ( entry->next != 0 )
+        domain_entry( domains, entry->next )->prev = entry->prev;
+    domains->lengths[entry->domain]--;
+    domains->length--;
+
+    MemDomainEntry *entries = domains->entries;
+    size_t capacity = domains->capacity;
+    size_t gap = ( size_t )( entry - entries );
+    size_t index = gap;
+    for ( ;; ) {
+        if ( ++index >= capacity )
+            index = 0;
+        if ( entries[index].location == 0 )
+            break;
+        size_t home = domain_home( entries[index].location, capacity );
+        bool stays = ( gap <= index ) ? ( gap < home && home <= index )
+                                      : ( gap < home || home <= index );
+        if ( !stays ) {
+            entries[gap] = entries[index];
+            gap = index;
+        }
+    }
+    entries[gap].location = 0;
+    // a failed shrink leaves the map as it is, which is still valid
+    if ( domains->length <= capacity / 4 && capacity / 2 >= DOMAIN_MIN_CAPACITY )
+        domain_resize( domains, capacity / 2 );
+    return true;
+}
+
+extern bool domain_contains( MemDomains* domains, uintptr_t location )
+{
+    return domain_entry( domains, location ) != NULL;
+}
+
+extern size_t domain_length( MemDomains* domains, unsigned int domain )
+{
+    return domain < DOMAIN_MAX ? domains->lengths[domain] : 0;
+}
+
+// the number of locations in any domain other than 0
+extern size_t domain_total( MemDomains* domains )
+{
+    return domains->length;
+}
+
+// returns the first location on domain's list, or 0 if it is empty
+extern uintptr_t domain_first( MemDomains* domains, unsigned int domain )
+{
+    return domain < DOMAIN_MAX ? domains->heads[domain] : 0;
+}
+
+// returns the location after location on its domain's list, or 0 at the end
+// (or if location isn't in a domain)
+extern uintptr_t domain_next( MemDomains* domains, uintptr_t location )
+{
+    MemDomainEntry *entry = domain_entry( domains, location );
+    return entry != NULL ? entry->next : 0;
+}
+
+extern size_t domain_memory( MemDomains* domains )
+{
+    return sizeof( MemDomains ) + domains->capacity * sizeof( MemDomainEntry );
+}
@@ -0,0 +1,426 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mem_range.h"
+
+// A B+ tree keyed on the start address. Leaves hold nothing but sorted start
+// addresses, so an allocation costs 8 bytes on 64 bit platforms divided by how
+// full its leaf is, and inner nodes add about 1/RANGE_INNER_KEYS of that
+// again. A binary tree needs at least two child references next to every
+// start on top of that.
+//
+// Every node but the root keeps at least half of its keys, except for leaves
+// split off at the end of the key space (see range_split_leaf), which fill up
+// as addresses keep increasing
+#define RANGE_NODE_SIZE 512
+#define RANGE_LEAF_KEYS \
+    ( ( RANGE_NODE_SIZE - sizeof( size_t ) ) / sizeof( uintptr_t ) )
+#define RANGE_INNER_KEYS \
+    ( ( RANGE_NODE_SIZE - 2 * sizeof( size_t ) ) \
+      / ( sizeof( uintptr_t ) + sizeof( void * ) ) )
+#define RANGE_LEAF_MIN ( RANGE_LEAF_KEYS / 2 )
+#define RANGE_INNER_MIN ( RANGE_INNER_KEYS / 2 )
+
+typedef struct {
+    size_t count;
+    uintptr_t keys[RANGE_LEAF_KEYS];
+} MemRangeLeaf;
+
+// every start below children[i] is at least keys[i - 1] and below keys[i]
+typedef struct {
+    size_t count; // of keys, there is one more child
+    uintptr_t keys[RANGE_INNER_KEYS];
+    void *children[RANGE_INNER_KEYS + 1];
+} MemRangeInner;
+
+// leaves and inner nodes are allocated at the same size, so that either can
+// be taken from the spare nodes
+typedef union MemRangeNode {
+    MemRangeLeaf leaf;
+    MemRangeInner inner;
+    union MemRangeNode *next_spare;
+} MemRangeNode;
+
+struct MemRange {
+    MemRangeNode *root; // NULL while empty
+    size_t height; // 0 when the root is a leaf
+    size_t length;
+    size_t n_nodes;
+    // an insert reserves a node for every split it might cause before it
+    // changes anything, so running out of memory never leaves it half done
+    MemRangeNode *spare;
+    size_t n_spare;
+};
+
+// number of keys at or below key
+static size_t range_upper_bound( const uintptr_t *keys, size_t count,
+                                 uintptr_t key )
+{
+    size_t low = 0, high = count;
+    while ( low < high ) {
+        size_t mid = low + ( high - low ) / 2;
+        if ( keys[mid] <= key )
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+static bool range_reserve( MemRange* range, size_t n )
+{
+    while ( range->n_spare < n ) {
+        MemRangeNode *node = malloc( sizeof( MemRangeNode ) );
+        if ( node == NULL )
+            return false;
+        node->next_spare = range->spare;
+        range->spare = node;
+        range->n_spare++;
+    }
+    return true;
+}
+
+// only called after range_reserve
+static MemRangeNode *range_take_node( MemRange* range )
+{
+    MemRangeNode *node = range->spare;
+    range->spare = node->next_spare;
+    range->n_spare--;
+    range->n_nodes++;
+    node->leaf.count = 0;
+    return node;
+}
+
+static void range_release_node( MemRange* range, MemRangeNode *node )
+{
+    range->n_nodes--;
+    // keep enough spares for the next insert
+    if ( range->n_spare < range->height + 2 ) {
+        node->next_spare = range->spare;
+        range->spare = node;
+        range->n_spare++;
+    } else {
+        free( node );
+    }
+}
+
+static void range_destroy_node( MemRangeNode *node, size_t height )
+{
+    if ( height > 0 ) {
+        for ( size_t i = 0; i <= node->inner.count; i++ )
+            range_destroy_node( node->inner.children[i], height - 1 );
+    }
+    free( node );
+}
+
+extern MemRange* range_init()
+{
+    MemRange* range = malloc( sizeof( MemRange ) );
+    if ( range == NULL )
+        return NULL;
+    range->root = NULL;
+    range->height = 0;
+    range->length = 0;
+    range->n_nodes = 0;
+    range->spare = NULL;
+    range->n_spare = 0;
+    return range;
+}
+
+extern void range_destroy( MemRange* range )
+{
+    if ( range->root != NULL )
+        range_destroy_node( range->root, range->height );
+    while ( range->spare != NULL ) {
+        MemRangeNode *node = range->spare;
+        range->spare = node->next_spare;
+        free( node );
+    }
+    free( range );
+}
+
+// a full leaf gets start at position, moving half of its keys to a new right
+// sibling. When start goes on the end of the leaf the new sibling only gets
+// start: malloc tends to hand out increasing addresses, and an even split
+// would leave every leaf behind the newest one half empty
+static MemRangeNode *range_split_leaf( MemRange* range, MemRangeLeaf *leaf,
+                                       size_t position, uintptr_t start )
+{
+    MemRangeNode *node = range_take_node( range );
+    MemRangeLeaf *right = &node->leaf;
+    uintptr_t keys[RANGE_LEAF_KEYS + 1];
+    memcpy( keys, leaf->keys, position * sizeof( uintptr_t ) );
+    keys[position] = start;
+    memcpy( &keys[position + 1], &leaf->keys[position],
+            ( leaf->count - position ) * sizeof( uintptr_t ) );
+    size_t left_count = position == leaf->count ? RANGE_LEAF_KEYS
+                                                : ( RANGE_LEAF_KEYS + 1 ) / 2;
+    leaf->count = left_count;
+    memcpy( leaf->keys, keys, left_count * sizeof( uintptr_t ) );
+    right->count = RANGE_LEAF_KEYS + 1 - left_count;
+    memcpy( right->keys, &keys[left_count], right->count * sizeof( uintptr_t ) );
+    return node;
+}
+
+// a full inner node gets key, and child to the right of it, at position,
+// moving half of them to a new right sibling. key_pointer is given back the
+// key that separates the two halves, for the parent
+static MemRangeNode *range_split_inner( MemRange* range, MemRangeInner *inner,
+                                        size_t position, uintptr_t *key_pointer,
+                                        MemRangeNode *child )
+{
+    MemRangeNode *node = range_take_node( range );
+    MemRangeInner *right = &node->inner;
+    uintptr_t keys[RANGE_INNER_KEYS + 1];
+    void *children[RANGE_INNER_KEYS + 2];
+    size_t count = inner->count;
+    memcpy( keys, inner->keys, position * sizeof( uintptr_t ) );
+    keys[position] = *key_pointer;
+    memcpy( &keys[position + 1], &inner->keys[position],
+            ( count - position ) * sizeof( uintptr_t ) );
+    memcpy( children, inner->children, ( position + 1 ) * sizeof( void * ) );
+    children[position + 1] = child;
+    memcpy( &children[position + 2], &inner->children[position + 1],
+            ( count - position ) * sizeof( void * ) );
+    count++;
+    size_t middle = count / 2;
+    inner->count = middle;
+    memcpy( inner->keys, keys, middle * sizeof( uintptr_t ) );
+    memcpy( inner->children, children, ( middle + 1 ) * sizeof( void * ) );
+    *key_pointer = keys[middle];
+    right->count = count - middle - 1;
+    memcpy( right->keys, &keys[middle + 1], right->count * sizeof( uintptr_t ) );
+    memcpy( right->children, &children[middle + 1],
+            ( right->count + 1 ) * sizeof( void * ) );
+    return node;
+}
+
+// adds start below node, returning the new right sibling if node had to
+// split (key_pointer is given the key that separates them) or NULL
+static MemRangeNode *range_insert_node( MemRange* range, MemRangeNode *node,
+                                        size_t height, uintptr_t start,
+                                        uintptr_t *key_pointer )
+{
+    if ( height == 0 ) {
+        MemRangeLeaf *leaf = &node->leaf;
+        size_t position = range_upper_bound( leaf->keys, leaf->count, start );
+        if ( position > 0 && leaf->keys[position - 1] == start )
+            return NULL;
+        range->length++;
+        if ( leaf->count == RANGE_LEAF_KEYS ) {
+            MemRangeNode *right = range_split_leaf( range, leaf, position,
+                                                    start );
+            *key_pointer = right->leaf.keys[0];
+            return right;
+        }
+        memmove( &leaf->keys[position + 1], &leaf->keys[position],
+                 ( leaf->count - position ) * sizeof( uintptr_t ) );
+        leaf->keys[position] = start;
+        leaf->count++;
+        return NULL;
+    }
+    MemRangeInner *inner = &node->inner;
+    size_t position = range_upper_bound( inner->keys, inner->count, start );
+    uintptr_t key;
+    MemRangeNode *child = range_insert_node( range, inner->children[position],
+                                             height - 1, start, &key );
+    if ( child == NULL )
+        return NULL;
+    if ( inner->count == RANGE_INNER_KEYS ) {
+        *key_pointer = key;
+        return range_split_inner( range, inner, position, key_pointer, child );
+    }
+    memmove( &inner->keys[position + 1], &inner->keys[position],
+             ( inner->count - position ) * sizeof( uintptr_t ) );
+    memmove( &inner->children[position + 2], &inner->children[position + 1],
+             ( inner->count - position ) * sizeof( void * ) );
+    inner->keys[position] = key;
+    inner->children[position + 1] = child;
+    inner->count++;
+    return NULL;
+}
+
+// records start (which must not be 0), returns false if out of memory
+extern bool range_insert( MemRange* range, uintptr_t start )
+{
+    // a split on every level, and a new root
+    if ( !range_reserve( range, range->height + 2 ) )
+        return false;
+    if ( range->root == NULL ) {
+        range->root = range_take_node( range );
+        range->height = 0;
+    }
+    uintptr_t key;
+    MemRangeNode *split = range_insert_node( range, range->root, range->height,
+                                             start, &key );
+    if ( split == NULL )
+        return true;
+    MemRangeNode *root = range_take_node( range );
+    root->inner.count = 1;
+    root->inner.keys[0] = key;
+    root->inner.children[0] = range->root;
+    root->inner.children[1] = split;
+    range->root = root;
+    range->height++;
+    return true;
+}
+
+static inline size_t range_count( MemRangeNode *node, size_t height )
+{
+    return height == 0 ? node->leaf.count : node->inner.count;
+}
+
+// parent's child at position lost a key, if that leaves it with too few they
+// are merged with (or one is borrowed from) a sibling
+static void range_rebalance( MemRange* range, MemRangeInner *parent,
+                             size_t position, size_t child_height )
+{
+    size_t min = child_height == 0 ? RANGE_LEAF_MIN : RANGE_INNER_MIN;
+    if ( range_count( parent->children[position], child_height ) >= min
+            || parent->count == 0 )
+        return;
+    // the child and its left sibling, or its right one if it has none
+    size_t i = position > 0 ? position - 1 : 0;
+    MemRangeNode *left = parent->children[i];
+    MemRangeNode *right = parent->children[i + 1];
+    bool merge;
+    if ( child_height == 0 ) {
+        MemRangeLeaf *l = &left->leaf, *r = &right->leaf;
+        merge = l->count + r->count <= RANGE_LEAF_KEYS;
+        if ( merge ) {
+            memcpy( &l->keys[l->count], r->keys, r->count * sizeof( uintptr_t ) );
+            l->count += r->count;
+        } else if ( i == position ) {
+            l->keys[l->count++] = r->keys[0];
+            memmove( r->keys, &r->keys[1], --r->count * sizeof( uintptr_t ) );
+            parent->keys[i] = r->keys[0];
+        } else {
+            memmove( &r->keys[1], r->keys, r->count++ * sizeof( uintptr_t ) );
+            r->keys[0] = l->keys[--l->count];
+            parent->keys[i] = r->keys[0];
+        }
+    } else {
+        MemRangeInner *l = &left->inner, *r = &right->inner;
+        merge = l->count + r->count + 1 <= RANGE_INNER_KEYS;
+        if ( merge ) {
+            l->keys[l->count] = parent->keys[i];
+            memcpy( &l->keys[l->count + 1], r->keys,
+                    r->count * sizeof( uintptr_t ) );
+            memcpy( &l->children[l->count + 1], r->children,
+                    ( r->count + 1 ) * sizeof( void * ) );
+            l->count += r->count + 1;
+        } else if ( i == position ) {
+            l->keys[l->count] = parent->keys[i];
+            l->children[++l->count] = r->children[0];
+            parent->keys[i] = r->keys[0];
+            r->count--;
+            memmove( r->keys, &r->keys[1], r->count * sizeof( uintptr_t ) );
+            memmove( r->children, &r->children[1],
+                     ( r->count + 1 ) * sizeof( void * ) );
+        } else {
+            memmove( &r->keys[1], r->keys, r->count * sizeof( uintptr_t ) );
+            memmove( &r->children[1], r->children,
+                     ( r->count + 1 ) * sizeof( void * ) );
+            r->keys[0] = parent->keys[i];
+            r->children[0] = l->children[l->count];
+            r->count++;
+            parent->keys[i] = l->keys[--l->count];
+        }
+    }
+    if ( merge ) {
+        range_release_node( range, right );
+        parent->count--;
+        memmove( &parent->keys[i], &parent->keys[i + 1],
+                 ( parent->count - i ) * sizeof( uintptr_t ) );
+        memmove( &parent->children[i + 1], &parent->children[i + 2],
+                 ( parent->count - i ) * sizeof( void * ) );
+    }
+}
+
+static bool range_remove_node( MemRange* range, MemRangeNode *node,
+                               size_t height, uintptr_t start )
+{
+    if ( height == 0 ) {
+        MemRangeLeaf *leaf = &node->leaf;
+        size_t position = range_upper_bound( leaf->keys, leaf->count, start );
+        if ( position == 0 || leaf->keys[position - 1] != start )
+            return false;
+        memmove( &leaf->keys[position - 1], &leaf->keys[position],
+                 ( leaf->count - position ) * sizeof( uintptr_t ) );
+        leaf->count--;
+        range->length--;
+        return true;
+    }
+    MemRangeInner *inner = &node->inner;
+    size_t position = range_upper_bound( inner->keys, inner->count, start );
+    if ( !range_remove_node( range, inner->children[position], height - 1,
+                             start ) )
+        return false;
+    range_rebalance( range, inner, position, height - 1 );
+    return true;
+}
+
+extern bool range_remove( MemRange* range, uintptr_t start )
+{
+    if ( range->root == NULL
+            || !range_remove_node( range, range->root, range->height, start ) )
+        return false;
+    MemRangeNode *root = range->root;
+    if ( range->height == 0 && root->leaf.count == 0 ) {
+        range->root = NULL;
+        range_release_node( range, root );
+    } else if ( range->height > 0 && root->inner.count == 0 ) {
+        range->root = root->inner.children[0];
+        range->height--;
+        range_release_node( range, root );
+    }
+    return true;
+}
+
+extern size_t range_memory( MemRange* range )
+{
+    return sizeof( MemRange )
+           + ( range->n_nodes + range->n_spare ) * sizeof( MemRangeNode );
+}
+
+// find the greatest start at or below address, the caller checks that address
+// is inside that allocation. Returns false if there is no such start
+extern bool range_find( MemRange* range, uintptr_t address,
+                        uintptr_t *start_pointer )
+{
+    MemRangeNode *node = range->root;
+    if ( node == NULL )
+        return false;
+    // the nearest subtree to the left of the path down, every start in it is
+    // below address
+    MemRangeNode *left = NULL;
+    size_t left_height = 0;
+    for ( size_t height = range->height; height > 0; height-- ) {
+        MemRangeInner *inner = &node->inner;
+        size_t position = range_upper_bound( inner->keys, inner->count,
+                                             address );
+        if ( position > 0 ) {
+            left = inner->children[position - 1];
+            left_height = height - 1;
+        }
+        node = inner->children[position];
+    }
+    MemRangeLeaf *leaf = &node->leaf;
+    size_t position = range_upper_bound( leaf->keys, leaf->count, address );
+    if ( position == 0 ) {
+        // every start in the leaf is above address, the one before address is
+        // the last start in the left subtree
+        if ( left == NULL )
+            return false;
+        for ( ; left_height > 0; left_height-- )
+            left = left->inner.children[left->inner.count];
+        leaf = &left->leaf;
+        position = leaf->count;
+        if ( position == 0 )
+            return false;
+    }
+    *start_pointer = leaf->keys[position - 1];
+    return true;
+}
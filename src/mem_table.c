@@ -4,12 +4,28 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <limits.h>
+#include <string.h>
 #include "mem_table.h"
+#include "mem_range.h"
+#include "mem_domain.h"
 
+#if defined( __GNUC__ ) || defined( __clang__ )
+#define TABLE_PREFETCH( address ) __builtin_prefetch( address )
+#else
+#define TABLE_PREFETCH( address ) ( ( void )( address ) )
+#endif
+// how many entries ahead the batch operations prefetch table slots
+#define TABLE_PREFETCH_DISTANCE 8
+
+// the table expands once it is 75% full, linear probing stays short at this
+// load because removal shifts entries back rather than leaving holes
+#define TABLE_MAX_LENGTH( capacity ) ( ( capacity ) * 3 / 4 )
+
+// 16 bytes on 64 bit platforms, the checksum is derived from the location
+// (table_checksum) rather than stored
 typedef struct {
     const void *location;
     size_t size;
-    checksum_t checksum;
 } MemHTFrame;
 
 struct MemHT {
@@ -17,6 +33,13 @@ struct MemHT {
     size_t capacity;
     size_t min_capacity;
     size_t length;
+    // the same allocations ordered by address, for interior pointer lookup.
+    // NULL until something needs it (table_build_ranges)
+    MemRange *ranges;
+    // the allocations in domains other than 0, NULL until one is used
+    MemDomains *domains;
+    // domain that newly set locations are added to
+    unsigned int domain;
 };
 
 // FNV-1a Hash, not secure, randomised or cryptographic, but
@@ -25,12 +48,44 @@ static uintptr_t table_hash( uintptr_t *key )
 {
     uintptr_t hash = FNV_OFFSET;
     for ( unsigned int i = 0; i < sizeof( uintptr_t ); i++ ) {
-        hash ^= ( uintptr_t )( unsigned char )( *( key + i ) );
+        hash ^= ( uintptr_t )( ( unsigned char * ) key )[i];
         hash *= FNV_PRIME;
     }
     return hash;
 }
 
+// the checksum only depends on the location, so it can be recomputed by
+// anyone who knows where (and how big) a buffer is without a table lookup.
+// it is the whole hash, so that every byte of it is likely to catch a stray
+// write
+extern checksum_t table_checksum( uintptr_t location )
+{
+    return ( checksum_t ) table_hash( &location );
+}
+
+static inline size_t table_home( uintptr_t location, size_t capacity )
+{
+    return ( size_t )( table_hash( &location ) % ( uintptr_t ) capacity );
+}
+
+// index of the entry for location, or capacity if it isn't in the table.
+// the probe ends at the first empty slot, removal guarantees that there are
+// no empty slots between an entry and its home slot
+static size_t table_find_index( MemHT* table, const void *location )
+{
+    if ( location == NULL )
+        return table->capacity;
+    size_t index = table_home( ( uintptr_t ) location, table->capacity );
+    MemHTFrame *entries = table->entries;
+    while ( entries[index].location != NULL ) {
+        if ( entries[index].location == location )
+            return index;
+        if ( ++index >= table->capacity )
+            index = 0;
+    }
+    return table->capacity;
+}
+
 // entry setting helper function
 static uintptr_t table_set_entry( MemHTFrame *entries, size_t capacity,
                                   uintptr_t location, size_t size,
@@ -55,24 +110,37 @@ static uintptr_t table_set_entry( MemHTFrame *entries, size_t capacity,
     // entry does not yet exist, create it and apply checksum to buffer
     entry->location = ( const void * ) location;
     entry->size = size;
-    entry->checksum = ( checksum_t )( hash % ( CHAR_BIT * sizeof( checksum_t ) ) );
-    *( checksum_t* ) &( ( char * ) entry->location ) [size] = entry->checksum;
+    checksum_t checksum = table_checksum( location );
+    // buffers may be any size, so the checksum is not necessarily aligned
+    memcpy( &( ( char * ) entry->location )[size], &checksum,
+            sizeof( checksum_t ) );
     if ( plength != NULL )
         ( *plength )++;
     return location;
 }
 
+// place an entry that is known not to be in entries yet, without touching the
+// buffer it describes. Rehashing must leave the canaries alone, otherwise an
+// overflow found before a resize would be gone after it
+static void table_move_entry( MemHTFrame *entries, size_t capacity,
+                              MemHTFrame entry )
+{
+    size_t index = table_home( ( uintptr_t ) entry.location, capacity );
+    while ( entries[index].location != NULL ) {
+        if ( ++index >= capacity )
+            index = 0;
+    }
+    entries[index] = entry;
+}
+
 static bool table_resize( MemHT* table, size_t new_capacity )
 {
     MemHTFrame* new_entries = calloc( new_capacity, sizeof( MemHTFrame ) );
     if ( new_entries == NULL )
         return false;
     for ( size_t i=0; i < table->capacity; i++ ) {
-        MemHTFrame entry = table->entries[i];
-        if ( entry.location != NULL ) {
-            table_set_entry( new_entries, new_capacity,
-                             ( uintptr_t ) entry.location, entry.size, NULL );
-        }
+        if ( table->entries[i].location != NULL )
+            table_move_entry( new_entries, new_capacity, table->entries[i] );
     }
     free( table->entries );
     table->entries = new_entries;
@@ -101,14 +169,64 @@ extern MemHT* table_init( size_t initial_capacity )
     ht->length = 0;
     ht->capacity = initial_capacity;
     ht->min_capacity = initial_capacity;
+    ht->domain = 0;
     ht->entries = calloc( ht->capacity, sizeof( MemHTFrame ) );
     if ( ht->entries == NULL ) {
         free( ht );
         return NULL;
     }
+    ht->ranges = NULL;
+    ht->domains = NULL;
     return ht;
 }
 
+static int table_compare_locations( const void *a, const void *b )
+{
+    uintptr_t x = *( const uintptr_t * ) a, y = *( const uintptr_t * ) b;
+    return ( x > y ) - ( x < y );
+}
+
+// the address index adds to what every allocation costs, so it is only built
+// (from the entries already in the table) the first time an interior pointer
+// is looked up. Programs that never do only pay for their hash table entries
+static bool table_build_ranges( MemHT* table )
+{
+    if ( table->ranges != NULL )
+        return true;
+    MemRange *ranges = range_init();
+    if ( ranges == NULL )
+        return false;
+    // inserted in address order the index packs its nodes full, in table
+    // order they'd be about two thirds full. Without memory to sort in, the
+    // table order will do
+    uintptr_t *starts = malloc( table->length * sizeof( uintptr_t ) + 1 );
+    size_t n = 0;
+    for ( size_t i = 0; i < table->capacity; i++ ) {
+        uintptr_t location = ( uintptr_t ) table->entries[i].location;
+        if ( location == 0 )
+            continue;
+        if ( starts != NULL )
+            starts[n++] = location;
+        else if ( !range_insert( ranges, location ) ) {
+            range_destroy( ranges );
+            return false;
+        }
+    }
+    if ( starts != NULL ) {
+        qsort( starts, n, sizeof( uintptr_t ), table_compare_locations );
+        for ( size_t i = 0; i < n; i++ ) {
+            if ( !range_insert( ranges, starts[i] ) ) {
+                free( starts );
+                range_destroy( ranges );
+                return false;
+            }
+        }
+        free( starts );
+    }
+    table->ranges = ranges;
+    return true;
+}
+
 extern size_t table_length( MemHT* table )
 {
     return table->length;
@@ -133,52 +251,173 @@ extern size_t table_destroy( MemHT* table )
             count++;
         }
     }
+    if ( table->ranges != NULL )
+        range_destroy( table->ranges );
+    if ( table->domains != NULL )
+        domain_destroy( table->domains );
     free( table->entries );
     free( table );
     return count;
 }
 
-// automatically expands the table if it is >=50% full
+static bool table_remove_entry( MemHT* table, const void *location,
+                                size_t *size_pointer );
+
+// record a newly set location in the address index (if it has been built)
+// and the current domain, returns false if out of memory
+static bool table_index_entry( MemHT* table, uintptr_t location )
+{
+    if ( table->ranges != NULL && !range_insert( table->ranges, location ) )
+        return false;
+    if ( table->domain != 0
+            && !domain_insert( table->domains, location, table->domain ) )
+        return false;
+    return true;
+}
+
+// automatically expands the table if it is >=75% full
 extern uintptr_t table_set( MemHT* table, uintptr_t location, size_t size )
 {
     /* assert( location != NULL ); */
-    if ( table->length >= table->capacity / 2 ) {
+    if ( table->length >= TABLE_MAX_LENGTH( table->capacity ) ) {
         if ( !table_expand( table ) )
             return ( uintptr_t ) NULL;
     }
-    return table_set_entry( table->entries, table->capacity,
-                            location, size, &table->length );
+    if ( !table_set_entry( table->entries, table->capacity,
+                           location, size, &table->length ) )
+        return ( uintptr_t ) NULL;
+    if ( !table_index_entry( table, location ) ) {
+        table_remove_entry( table, ( const void * ) location, NULL );
+        return ( uintptr_t ) NULL;
+    }
+    return location;
+}
+
+// removal helper, does not shrink the table. size_pointer (if not NULL) is
+// given the size the location was recorded with.
+// entries after the removed one are shifted back into the gap (as far as
+// their home slot allows) so that probes can stop at the first empty slot
+static bool table_remove_entry( MemHT* table, const void *location,
+                                size_t *size_pointer )
+{
+    size_t gap = table_find_index( table, location );
+    if ( gap == table->capacity )
+        return false;
+    if ( size_pointer != NULL )
+        *size_pointer = table->entries[gap].size;
+    MemHTFrame *entries = table->entries;
+    size_t capacity = table->capacity;
+    size_t index = gap;
+    for ( ;; ) {
+        if ( ++index >= capacity )
+            index = 0;
+        if ( entries[index].location == NULL )
+            break;
+        size_t home = table_home( ( uintptr_t ) entries[index].location,
+                                  capacity );
+        // the entry can move into the gap unless its home slot lies
+        // cyclically in (gap, index]
+        bool stays = ( gap <= index ) ? ( gap < home && home <= index )
+                                      : ( gap < home || home <= index );
+        if ( !stays ) {
+            entries[gap] = entries[index];
+            gap = index;
+        }
+    }
+    entries[gap].location = NULL;
+    entries[gap].size = 0;
+    table->length--;
+    if ( table->ranges != NULL )
+        range_remove( table->ranges, ( uintptr_t ) location );
+    if ( table->domains != NULL )
+        domain_remove( table->domains, ( uintptr_t ) location );
+    return true;
 }
 
 extern bool table_remove( MemHT* table, const void *location )
+{
+    return table_take( table, location, NULL );
+}
+
+// as table_remove, also populating size_pointer (if not NULL) with the size
+// the location was recorded with
+extern bool table_take( MemHT* table, const void *location,
+                        size_t *size_pointer )
 {
     if ( table->length <= table->capacity / 4 ) {
         if ( !table_shrink( table ) )
             return false;
     }
+    return table_remove_entry( table, location, size_pointer );
+}
 
-    uintptr_t hash = table_hash( ( uintptr_t * ) &location );
-    size_t index = ( size_t )( hash % ( uintptr_t ) ( table->capacity ) );
-    size_t index_start = index;
-    MemHTFrame *entries = table->entries;
-    MemHTFrame *entry = &entries[index];
-    do {
-        bool cmp = ( uintptr_t )( entry->location )
-                   == ( uintptr_t )( location );
-        if ( cmp ) {
-            entry->location = NULL;
-            entry->size = 0;
-            entry->checksum = 0;
-            table->length--;
-            return true;
+// grow the table (with a single resize) so that another `additional` entries
+// can be set without it expanding
+extern bool table_reserve( MemHT* table, size_t additional )
+{
+    size_t new_capacity = table->capacity;
+    while ( table->length + additional > TABLE_MAX_LENGTH( new_capacity ) )
+        new_capacity *= 2;
+    if ( new_capacity == table->capacity )
+        return true;
+    return table_resize( table, new_capacity );
+}
+
+// set `count` locations of the same size, reserving space for them first,
+// returns the number of locations set
+extern size_t table_set_batch( MemHT* table, void *const *locations,
+                               size_t count, size_t size )
+{
+    size_t set = 0;
+    if ( !table_reserve( table, count ) ) {
+        // fall back to growing as we go
+        for ( size_t i = 0; i < count; i++ ) {
+            if ( table_set( table, ( uintptr_t ) locations[i], size ) )
+                set++;
         }
-        entry = &entries[++index];
-        if ( index >= table->capacity ) {
-            index = 0;
-            entry = &entries[index];
+        return set;
+    }
+    for ( size_t i = 0; i < count; i++ ) {
+        if ( i + TABLE_PREFETCH_DISTANCE < count ) {
+            uintptr_t ahead = ( uintptr_t ) locations[i + TABLE_PREFETCH_DISTANCE];
+            TABLE_PREFETCH( &table->entries[table_hash( &ahead )
+                                            % ( uintptr_t ) table->capacity] );
         }
-    } while ( index != index_start ); // wrapped around
-    return false;
+        if ( !table_set_entry( table->entries, table->capacity,
+                               ( uintptr_t ) locations[i], size,
+                               &table->length ) )
+            continue;
+        if ( table_index_entry( table, ( uintptr_t ) locations[i] ) )
+            set++;
+        else
+            table_remove_entry( table, locations[i], NULL );
+    }
+    return set;
+}
+
+// remove `count` locations, shrinking the table (at most once) afterwards,
+// NULL locations are skipped. Returns the number of locations removed
+extern size_t table_remove_batch( MemHT* table, void *const *locations,
+                                  size_t count )
+{
+    size_t removed = 0;
+    for ( size_t i = 0; i < count; i++ ) {
+        if ( i + TABLE_PREFETCH_DISTANCE < count ) {
+            uintptr_t ahead = ( uintptr_t ) locations[i + TABLE_PREFETCH_DISTANCE];
+            TABLE_PREFETCH( &table->entries[table_hash( &ahead )
+                                            % ( uintptr_t ) table->capacity] );
+        }
+        if ( locations[i] != NULL
+                && table_remove_entry( table, locations[i], NULL ) )
+            removed++;
+    }
+    size_t new_capacity = table->capacity;
+    while ( table->length <= new_capacity / 4
+            && new_capacity / 2 >= table->min_capacity )
+        new_capacity /= 2;
+    if ( new_capacity != table->capacity )
+        table_resize( table, new_capacity );
+    return removed;
 }
 
 // populate the given size_pointer and checksum_pointer with the values
@@ -186,50 +425,134 @@ extern bool table_remove( MemHT* table, const void *location )
 extern bool table_get( MemHT* table, const void *location,
                        size_t *size_pointer, checksum_t *checksum_pointer )
 {
-    uintptr_t hash = table_hash( ( uintptr_t * ) &location );
-    size_t index = ( size_t ) ( hash % ( uintptr_t ) ( table->capacity ) );
-    size_t index_start = index;
-    MemHTFrame *entries = table->entries;
-    MemHTFrame *entry = &entries[index];
-    do {
-        bool cmp = ( uintptr_t )( entry->location )
-                   == ( uintptr_t )( location );
-        if ( cmp ) {
-            *size_pointer = entry->size;
-            *checksum_pointer = entry->checksum;
-            return true;
-        }
-        entry = &entries[++index];
-        if ( index >= table->capacity ) {
-            index = 0;
-            entry = &entries[index];
-        }
-    } while ( index != index_start );
-    return false;
+    size_t index = table_find_index( table, location );
+    if ( index == table->capacity )
+        return false;
+    *size_pointer = table->entries[index].size;
+    *checksum_pointer = table_checksum( ( uintptr_t ) location );
+    return true;
 }
 
-
 extern HTIter table_iterator( MemHT* table )
 {
     HTIter iter;
     iter._table = table;
     iter._index = 0;
+    iter._by_domain = false;
+    iter._domain = 0;
+    iter._next = 0;
+    return iter;
+}
+
+// iterates over only the locations in domain. A domain other than 0 is
+// walked through its own list, without visiting the rest of the table.
+// Domain 0 has no list, its iterator goes through the whole table (which is
+// at most four times as big as the number of locations in it) and skips the
+// locations which are in another domain
+extern HTIter table_domain_iterator( MemHT* table, unsigned int domain )
+{
+    HTIter iter = table_iterator( table );
+    iter._domain = domain;
+    if ( domain != 0 ) {
+        iter._by_domain = true;
+        iter._next = table->domains != NULL
+                     ? domain_first( table->domains, domain ) : 0;
+    }
     return iter;
 }
 
 extern bool table_iter_next( HTIter* iterator )
 {
     MemHT* table = iterator->_table;
+    if ( iterator->_by_domain ) {
+        while ( iterator->_next != 0 ) {
+            uintptr_t location = iterator->_next;
+            iterator->_next = domain_next( table->domains, location );
+            // every location on a list is in the table, but don't trust that
+            // with an index into it
+            size_t index = table_find_index( table, ( const void * ) location );
+            if ( index == table->capacity )
+                continue;
+            iterator->location = ( const void * ) location;
+            iterator->size = table->entries[index].size;
+            iterator->checksum = table_checksum( location );
+            return true;
+        }
+        return false;
+    }
+    bool skip_domains = iterator->_domain == 0 && table->domains != NULL
+                        && domain_total( table->domains ) > 0;
     while ( iterator->_index < table->capacity ) {
         size_t i = iterator->_index;
         iterator->_index++;
-        if ( table->entries[i].location != NULL ) {
+        if ( table->entries[i].location != NULL && !( skip_domains
+                && domain_contains( table->domains,
+                                    ( uintptr_t ) table->entries[i].location ) ) ) {
             MemHTFrame *entry = &( table->entries[i] );
             iterator->location = entry->location;
             iterator->size = entry->size;
-            iterator->checksum = entry->checksum;
+            iterator->checksum = table_checksum( ( uintptr_t ) entry->location );
             return true;
         }
     }
     return false;
 }
+
+// find the allocation containing address, which need not be the start of it.
+// populates the given pointers as table_get does, plus the allocation's start
+// location. Returns false if address is not inside any allocation (or the
+// address index could not be built)
+extern bool table_find( MemHT* table, const void *address,
+                        const void **location_pointer, size_t *size_pointer,
+                        checksum_t *checksum_pointer )
+{
+    uintptr_t start;
+    if ( !table_build_ranges( table ) )
+        return false;
+    if ( !range_find( table->ranges, ( uintptr_t ) address, &start ) )
+        return false;
+    size_t index = table_find_index( table, ( const void * ) start );
+    if ( index == table->capacity )
+        return false;
+    // a zero sized allocation only contains its start
+    size_t size = table->entries[index].size;
+    if ( ( uintptr_t ) address - start >= size && ( uintptr_t ) address != start )
+        return false;
+    *location_pointer = ( const void * ) start;
+    *size_pointer = size;
+    *checksum_pointer = table_checksum( start );
+    return true;
+}
+
+// bytes used to track the allocations currently in the table
+extern size_t table_memory( MemHT* table )
+{
+    return sizeof( MemHT ) + table->capacity * sizeof( MemHTFrame )
+           + ( table->ranges != NULL ? range_memory( table->ranges ) : 0 )
+           + ( table->domains != NULL ? domain_memory( table->domains ) : 0 );
+}
+
+// locations set from now on are added to domain, returns false if domain is
+// out of range or the map that keeps track of domains could not be allocated
+extern bool table_set_domain( MemHT* table, unsigned int domain )
+{
+    if ( domain >= DOMAIN_MAX )
+        return false;
+    if ( domain != 0 && table->domains == NULL ) {
+        table->domains = domain_init();
+        if ( table->domains == NULL )
+            return false;
+    }
+    table->domain = domain;
+    return true;
+}
+
+// O(1), domain 0 being every location that isn't in another domain
+extern size_t table_domain_length( MemHT* table, unsigned int domain )
+{
+    if ( table->domains == NULL )
+        return domain == 0 ? table->length : 0;
+    if ( domain == 0 )
+        return table->length - domain_total( table->domains );
+    return domain_length( table->domains, domain );
+}
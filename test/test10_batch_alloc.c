@@ -0,0 +1,46 @@
+#define DEBUG_MEM_ENABLE
+#include <debug_mem.h>
+#include <limits.h>
+#include <inttypes.h>
+#include <assert.h>
+
+#define TESTNAME "test10_batch_alloc"
+int main()
+{
+#ifdef DEBUG_MEM_ENABLE
+    int err = debug_mem_init( "memory_" TESTNAME ".log", 10 );
+    if ( err ) {
+        fprintf( stderr, "Failed to initialise memory debugger\n" );
+        return 1;
+    }
+#endif
+    int *buffers[1000];
+    int buffer_size = 10;
+    int result = malloc_batch( buffers, 1000, sizeof( int ) * buffer_size );
+    assert( result == 0 );
+    for ( size_t i = 0; i < 1000; i++ ) {
+        buffers[i][buffer_size - 1] = ( int ) i;
+    }
+#ifdef DEBUG_MEM_ENABLE
+    assert( debug_mem_table_length() == 1000 );
+    assert( debug_mem_table_capacity() * 3 / 4 >= 1000 );
+    assert( debug_mem_check_all() == 0 );
+    // batch and single frees are interchangeable
+    assert( debug_mem_check( buffers[999] ) == 0 );
+#endif
+    free( buffers[999] );
+    free_batch( buffers, 999 );
+    // sizes with no room for the checksum fail as a whole
+    result = malloc_batch( buffers, 3, SIZE_MAX );
+    assert( result == 1 );
+    assert( buffers[0] == NULL && buffers[2] == NULL );
+    void *huge = calloc( SIZE_MAX / 2, 4 );
+    assert( huge == NULL );
+#ifdef DEBUG_MEM_ENABLE
+    assert( debug_mem_table_length() == 0 );
+    assert( debug_mem_table_capacity() == 10 );
+    size_t n = debug_mem_end();
+    assert ( n == 0 );
+#endif
+    return 0;
+}
@@ -0,0 +1,58 @@
+#define DEBUG_MEM_ENABLE
+#include <debug_mem.h>
+#include <limits.h>
+#include <inttypes.h>
+#include <assert.h>
+
+#define TESTNAME "test11_interior_pointer"
+int main()
+{
+#ifdef DEBUG_MEM_ENABLE
+    int err = debug_mem_init( "memory_" TESTNAME ".log", 10 );
+    if ( err ) {
+        fprintf( stderr, "Failed to initialise memory debugger\n" );
+        return 1;
+    }
+#endif
+    char *buffers[5000];
+    int buffer_size = 100;
+    for ( size_t i = 0; i < 5000; i++ ) {
+        buffers[i] = malloc( buffer_size );
+    }
+    // enough for more than one level of index, with gaps in it
+    for ( size_t i = 0; i < 5000; i += 2 ) {
+        free( buffers[i] );
+    }
+    char *buffer = buffers[101];
+    char *inside = pass_pointer( char *, buffer + 50 );
+#ifdef DEBUG_MEM_ENABLE
+    // the address index is only built by the first interior lookup
+    size_t table_bytes = debug_mem_table_memory();
+    assert( debug_mem_check( buffer ) == 0 );
+    assert( debug_mem_table_memory() == table_bytes );
+    assert( debug_mem_check( inside ) == 0 );
+    assert( debug_mem_table_memory() > table_bytes );
+    assert( debug_mem_check_range( inside, 50 ) == 0 );
+    assert( debug_mem_check_range( inside, 51 ) == 1 );
+    assert( debug_mem_check_range( buffer + buffer_size - 1, 1 ) == 0 );
+    assert( debug_mem_check_range( &buffer_size, 1 ) == -1 );
+    for ( size_t i = 1; i < 5000; i += 2 ) {
+        assert( debug_mem_check_range( buffers[i] + i % buffer_size, 1 ) == 0 );
+    }
+#endif
+    // overwrite the checksum portion of the buffer
+    buffer[buffer_size] = ( char ) ~buffer[buffer_size];
+#ifdef DEBUG_MEM_ENABLE
+    assert( debug_mem_check( inside ) == 1 );
+    assert( debug_mem_check_range( inside, 10 ) == 1 );
+#endif
+    for ( size_t i = 1; i < 5000; i += 2 ) {
+        free( buffers[i] );
+    }
+#ifdef DEBUG_MEM_ENABLE
+    assert( debug_mem_check( inside ) == -1 );
+    size_t n = debug_mem_end();
+    assert ( n == 0 );
+#endif
+    return 0;
+}
@@ -0,0 +1,46 @@
+#define DEBUG_MEM_ENABLE
+#include <debug_mem.h>
+#include <limits.h>
+#include <inttypes.h>
+#include <assert.h>
+
+#define TESTNAME "test12_table_probe_after_remove"
+int main()
+{
+#ifdef DEBUG_MEM_ENABLE
+    int err = debug_mem_init( "memory_" TESTNAME ".log", 10 );
+    if ( err ) {
+        fprintf( stderr, "Failed to initialise memory debugger\n" );
+        return 1;
+    }
+#endif
+    char *buffers[500];
+    for ( size_t i = 0; i < 500; i++ ) {
+        buffers[i] = malloc( i + 1 );
+    }
+    // remove entries from the middle of probe sequences
+    for ( size_t i = 0; i < 500; i++ ) {
+        if ( i % 3 != 0 ) {
+            free( buffers[i] );
+            buffers[i] = NULL;
+        }
+    }
+#ifdef DEBUG_MEM_ENABLE
+    assert( debug_mem_table_length() == 167 );
+    for ( size_t i = 0; i < 500; i += 3 ) {
+        assert( debug_mem_check( buffers[i] ) == 0 );
+    }
+    assert( debug_mem_check_all() == 0 );
+    // the table never fills past 75%
+    assert( debug_mem_table_capacity() * 3 / 4 >= debug_mem_table_length() );
+#endif
+    for ( size_t i = 0; i < 500; i += 3 ) {
+        free( buffers[i] );
+    }
+#ifdef DEBUG_MEM_ENABLE
+    assert( debug_mem_table_length() == 0 );
+    size_t n = debug_mem_end();
+    assert ( n == 0 );
+#endif
+    return 0;
+}
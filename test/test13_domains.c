@@ -0,0 +1,76 @@
+#define DEBUG_MEM_ENABLE
+#include <debug_mem.h>
+#include <limits.h>
+#include <inttypes.h>
+#include <assert.h>
+
+#define TESTNAME "test13_domains"
+int main()
+{
+#ifdef DEBUG_MEM_ENABLE
+    int err = debug_mem_init( "memory_" TESTNAME ".log", 10 );
+    if ( err ) {
+        fprintf( stderr, "Failed to initialise memory debugger\n" );
+        return 1;
+    }
+#endif
+    // allocated before any domain exists, so in domain 0
+    char *early = malloc( 10 );
+#ifdef DEBUG_MEM_ENABLE
+    // looking a name up doesn't register it
+    assert( debug_mem_domain( "parser" ) == -1 );
+    assert( debug_mem_domain_length( 1 ) == 0 );
+    int parser = debug_mem_domain_push( "parser" );
+    assert( parser > 0 );
+#endif
+    char *parsed[3];
+    for ( size_t i = 0; i < 3; i++ ) {
+        parsed[i] = malloc( 10 );
+    }
+#ifdef DEBUG_MEM_ENABLE
+    int network = debug_mem_domain_push( "network" );
+    assert( network > 0 && network != parser );
+#endif
+    char *packets[20];
+    int result = malloc_batch( packets, 20, 64 );
+    assert( result == 0 );
+    // overwrite the checksum portion of one buffer
+    packets[7][64] = ( char ) ~packets[7][64];
+#ifdef DEBUG_MEM_ENABLE
+    int popped = debug_mem_domain_pop();
+    assert( popped == network );
+    popped = debug_mem_domain_pop();
+    assert( popped == parser );
+    popped = debug_mem_domain_pop();
+    assert( popped == -1 );
+#endif
+    char *other = malloc( 10 );
+#ifdef DEBUG_MEM_ENABLE
+    assert( debug_mem_domain( "parser" ) == parser );
+    assert( debug_mem_domain( "unknown" ) == -1 );
+    assert( debug_mem_domain_length( parser ) == 3 );
+    assert( debug_mem_domain_length( network ) == 20 );
+    assert( debug_mem_domain_length( 0 ) == 2 );
+    assert( debug_mem_domain_check_all( parser ) == 0 );
+    assert( debug_mem_domain_check_all( network ) == 1 );
+    assert( debug_mem_domain_check_all( 0 ) == 0 );
+    assert( debug_mem_domain_report( parser ) == 3 );
+#endif
+    free( parsed[1] );
+    free_batch( packets, 20 );
+#ifdef DEBUG_MEM_ENABLE
+    assert( debug_mem_domain_length( parser ) == 2 );
+    assert( debug_mem_domain_length( network ) == 0 );
+    assert( debug_mem_domain_report( network ) == 0 );
+#endif
+    free( parsed[0] );
+    free( parsed[2] );
+    free( other );
+    free( early );
+#ifdef DEBUG_MEM_ENABLE
+    assert( debug_mem_domain_length( parser ) == 0 );
+    size_t n = debug_mem_end();
+    assert ( n == 0 );
+#endif
+    return 0;
+}
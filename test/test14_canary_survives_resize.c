@@ -0,0 +1,56 @@
+#define DEBUG_MEM_ENABLE
+#include <debug_mem.h>
+#include <limits.h>
+#include <inttypes.h>
+#include <assert.h>
+
+#define TESTNAME "test14_canary_survives_resize"
+int main()
+{
+#ifdef DEBUG_MEM_ENABLE
+    int err = debug_mem_init( "memory_" TESTNAME ".log", 10 );
+    if ( err ) {
+        fprintf( stderr, "Failed to initialise memory debugger\n" );
+        return 1;
+    }
+#endif
+    char *buffer = malloc( 10 );
+    // overwrite the checksum portion of the buffer
+    buffer[10] = ( char ) ~buffer[10];
+#ifdef DEBUG_MEM_ENABLE
+    int checked = debug_mem_check( buffer );
+    assert( checked == 1 );
+#endif
+    // grow the table one allocation at a time, the overflow must still show
+    char *buffers[20];
+    for ( size_t i = 0; i < 20; i++ ) {
+        buffers[i] = malloc( 16 );
+    }
+#ifdef DEBUG_MEM_ENABLE
+    checked = debug_mem_check( buffer );
+    assert( checked == 1 );
+#endif
+    // and again when a batch reserves room for itself
+    char *batch[100];
+    int result = malloc_batch( batch, 100, 16 );
+    assert( result == 0 );
+#ifdef DEBUG_MEM_ENABLE
+    checked = debug_mem_check( buffer );
+    assert( checked == 1 );
+#endif
+    // shrinking rehashes too
+    free_batch( batch, 100 );
+    for ( size_t i = 0; i < 20; i++ ) {
+        free( buffers[i] );
+    }
+#ifdef DEBUG_MEM_ENABLE
+    checked = debug_mem_check( buffer );
+    assert( checked == 1 );
+#endif
+    free( buffer );
+#ifdef DEBUG_MEM_ENABLE
+    size_t n = debug_mem_end();
+    assert ( n == 0 );
+#endif
+    return 0;
+}
@@ -18,7 +18,9 @@ int main()
     int buffer_size = 4000;
     buffer = malloc( sizeof &buffer * buffer_size );
     // overwrite the checksum portion of the buffer
-    ( ( uint8_t * ) buffer )[buffer_size * sizeof &buffer] = 6;
+    uint8_t *checksum_byte =
+        &( ( uint8_t * ) buffer )[buffer_size * sizeof &buffer];
+    *checksum_byte = ( uint8_t ) ~*checksum_byte;
 #ifdef DEBUG_MEM_ENABLE
     assert( debug_mem_check( buffer ) == 1 );
 #endif
@@ -20,7 +20,9 @@ int main()
     int *buf2;
     buf2 = malloc( sizeof &buffer * buffer_size );
     // overwrite part of the checksum portion of the buffer
-    ( ( uint8_t * ) buffer )[buffer_size * sizeof &buffer] = 6;
+    uint8_t *checksum_byte =
+        &( ( uint8_t * ) buffer )[buffer_size * sizeof &buffer];
+    *checksum_byte = ( uint8_t ) ~*checksum_byte;
 #ifdef DEBUG_MEM_ENABLE
     assert( debug_mem_check_all( ) == 1 );
 #endif
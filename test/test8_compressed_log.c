@@ -0,0 +1,89 @@
+#define DEBUG_MEM_ENABLE
+#include <debug_mem.h>
+#include <limits.h>
+#include <inttypes.h>
+#include <assert.h>
+#include <string.h>
+#include "log_compress.h"
+
+#define TESTNAME "test8_compressed_log"
+int main()
+{
+#ifdef DEBUG_MEM_ENABLE
+    int err = debug_mem_init_compressed( "memory_" TESTNAME ".log", 10 );
+    if ( err ) {
+        fprintf( stderr, "Failed to initialise memory debugger\n" );
+        return 1;
+    }
+#endif
+    int *buffers[100];
+    uintptr_t first_round[100];
+    unsigned int malloc_line = 0;
+    // enough log records to fill several compression blocks
+    for ( size_t round = 0; round < 100; round++ ) {
+        for ( size_t i = 0; i < 100; i++ ) {
+            malloc_line = __LINE__ + 1;
+            buffers[i] = malloc( sizeof( int ) * ( i + 1 ) );
+            buffers[i][0] = ( int ) i;
+            if ( round == 0 )
+                first_round[i] = ( uintptr_t ) buffers[i];
+        }
+        for ( size_t i = 0; i < 100; i++ ) {
+            free( buffers[i] );
+        }
+    }
+    // a batch record, and a line logged as text
+    void *batch[3];
+    unsigned int batch_line = __LINE__ + 1;
+    int result = malloc_batch( batch, 3, 8 );
+    assert( result == 0 );
+#ifdef DEBUG_MEM_ENABLE
+    int checked = debug_mem_check( batch[1] );
+    assert( checked == 0 );
+#endif
+    free_batch( batch, 3 );
+#ifdef DEBUG_MEM_ENABLE
+    size_t n = debug_mem_end();
+    assert ( n == 0 );
+
+    FILE *compressed = fopen( "memory_" TESTNAME ".log", "rb" );
+    FILE *plain = fopen( "memory_" TESTNAME "_plain.log", "w+" );
+    assert( compressed != NULL && plain != NULL );
+    int status = log_decompress_stream( compressed, plain );
+    assert( status == 0 );
+    long compressed_size = ftell( compressed );
+    long plain_size = ftell( plain );
+    assert( plain_size > 10 * compressed_size );
+
+    // records are rendered exactly as the plain log would have them
+    char line[256], expected[256];
+    size_t lines = 0;
+    rewind( plain );
+    while ( fgets( line, sizeof( line ), plain ) != NULL ) {
+        if ( lines < 100 ) {
+            snprintf( expected, sizeof( expected ),
+                      "%s, main (line %u): malloc(%zu) -> @%" PRIXPTR "\n",
+                      __FILE__, malloc_line, sizeof( int ) * ( lines + 1 ),
+                      first_round[lines] );
+            assert( strcmp( line, expected ) == 0 );
+        } else if ( lines == 100 * 200 ) {
+            snprintf( expected, sizeof( expected ),
+                      "%s, main (line %u): malloc_batch(3, 8) -> @%" PRIXPTR
+                      " @%" PRIXPTR " @%" PRIXPTR "\n", __FILE__, batch_line,
+                      ( uintptr_t ) batch[0], ( uintptr_t ) batch[1],
+                      ( uintptr_t ) batch[2] );
+            assert( strcmp( line, expected ) == 0 );
+        } else if ( lines == 100 * 200 + 1 ) {
+            assert( strncmp( line, "Checking buffer @", 17 ) == 0 );
+        }
+        lines++;
+    }
+    assert( lines == 100 * 200 + 4 );
+    // last line of the log survives the final (partial) block
+    assert( strcmp( line,
+                    "Destroyed allocation table with 0 un-freed items\n" ) == 0 );
+    fclose( compressed );
+    fclose( plain );
+#endif
+    return 0;
+}
@@ -0,0 +1,86 @@
+#define DEBUG_MEM_ENABLE
+#include <cassert>
+#include <cinttypes>
+#include <cstdint>
+#include <new>
+#include <vector>
+#include <debug_mem.hpp>
+
+#define TESTNAME "test9_cpp_new_delete"
+
+struct alignas( 64 ) CacheLine {
+    char data[64];
+};
+
+int main()
+{
+#ifdef DEBUG_MEM_ENABLE
+    int err = debug_mem_init( "memory_" TESTNAME ".log", 10 );
+    if ( err ) {
+        fprintf( stderr, "Failed to initialise memory debugger\n" );
+        return 1;
+    }
+#endif
+    size_t baseline = debug_mem_table_length();
+
+    int *single = new int( 5 );
+    int *array = new int[10];
+    CacheLine *line = new CacheLine;
+    CacheLine *lines = new CacheLine[3];
+    int *nothrow = new ( std::nothrow ) int( 6 );
+    assert( reinterpret_cast<std::uintptr_t>( line ) % 64 == 0 );
+    assert( reinterpret_cast<std::uintptr_t>( lines ) % 64 == 0 );
+    assert( debug_mem_table_length() == baseline + 5 );
+    delete single;
+    delete[] array;
+    delete line;
+    delete[] lines;
+    delete nothrow;
+    assert( debug_mem_table_length() == baseline );
+
+    {
+        std::vector<int, debug_mem::allocator<int>> v;
+        for ( int i = 0; i < 1000; i++ )
+            v.push_back( i );
+        assert( debug_mem_table_length() == baseline + 1 );
+    }
+    assert( debug_mem_table_length() == baseline );
+
+    // the sized free path verifies the checksum it is given the size of
+    char *buffer = static_cast<char *>( malloc( 10 ) );
+    buffer[10] = static_cast<char>( ~buffer[10] );
+    int corrupt = debug_mem_free_sized( buffer, 10, __FILE__, __LINE__,
+                                        __func__ );
+    assert( corrupt == 1 );
+    buffer = static_cast<char *>( malloc( 10 ) );
+    int intact = debug_mem_free_sized( buffer, 10, __FILE__, __LINE__,
+                                       __func__ );
+    assert( intact == 0 );
+    // a size which doesn't match the allocation is reported, and the
+    // checksum is still read from where the allocation really ends
+    buffer = static_cast<char *>( malloc( 10 ) );
+    int mismatch = debug_mem_free_sized( buffer, 20, __FILE__, __LINE__,
+                                         __func__ );
+    assert( mismatch == 1 );
+
+    // sizes with no room left for the checksum fail rather than wrapping
+    volatile std::size_t huge = SIZE_MAX;
+    void *huge_malloc = malloc( huge );
+    assert( huge_malloc == nullptr );
+    void *huge_nothrow = ::operator new( huge, std::nothrow );
+    assert( huge_nothrow == nullptr );
+    bool threw = false;
+    try {
+        void *huge_new = ::operator new( huge );
+        ::operator delete( huge_new );
+    } catch ( const std::bad_alloc& ) {
+        threw = true;
+    }
+    assert( threw );
+    assert( debug_mem_table_length() == baseline );
+#ifdef DEBUG_MEM_ENABLE
+    size_t n = debug_mem_end();
+    assert ( n == 0 );
+#endif
+    return 0;
+}
@@ -0,0 +1,49 @@
+/*
+ * Reads a log written after debug_mem_init_compressed and writes the plain
+ * text log, as debug_mem_init would have produced it.
+ *
+ * usage: debug_mem_decompress <compressed log> [output file]
+ * output goes to stdout when no output file is given.
+ */
+#include <stdio.h>
+#include "log_compress.h"
+
+int main( int argc, char **argv )
+{
+    if ( argc < 2 || argc > 3 ) {
+        fprintf( stderr, "usage: %s <compressed log> [output file]\n",
+                 argv[0] );
+        return 1;
+    }
+    FILE *in = fopen( argv[1], "rb" );
+    if ( in == NULL ) {
+        fprintf( stderr, "Failed to open %s\n", argv[1] );
+        return 1;
+    }
+    FILE *out = stdout;
+    if ( argc == 3 ) {
+        out = fopen( argv[2], "w" );
+        if ( out == NULL ) {
+            fprintf( stderr, "Failed to open %s\n", argv[2] );
+            fclose( in );
+            return 1;
+        }
+    }
+    int status = log_decompress_stream( in, out );
+    switch ( status ) {
+    case 1:
+        fprintf( stderr, "%s is not a compressed debug_mem log\n", argv[1] );
+        break;
+    case 2:
+        fprintf( stderr, "%s is truncated or corrupt, "
+                 "output stops at the last complete block\n", argv[1] );
+        break;
+    case 3:
+        fprintf( stderr, "Failed to write decompressed log\n" );
+        break;
+    }
+    fclose( in );
+    if ( out != stdout )
+        fclose( out );
+    return status;
+}